@@ -0,0 +1,135 @@
+#include "analysis.h"
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+#include <stdint.h>
+
+static const size_t MIN_DEPTH       = 4;
+static const double MIN_COINCIDENCE = 2.0;
+static const double MAX_DISTANCE    = 0.85; // of mean distance over all periods
+static const size_t MAX_COLUMNS     = 1 << 14;
+
+static size_t hammingScalar( const unsigned char * a, const unsigned char * b, size_t length ) {
+    size_t bits = 0, i = 0;
+    for ( ; i + 8 <= length; i += 8 ) {
+        uint64_t x, y;
+        std::memcpy( &x, a + i, 8 );
+        std::memcpy( &y, b + i, 8 );
+        bits += __builtin_popcountll( x ^ y );
+    }
+    for ( ; i < length; i++ ) {
+        bits += __builtin_popcount( a[i] ^ b[i] );
+    }
+    return bits;
+}
+
+/*
+ * Population count by nibble lookup, byte counts are summed with psadbw
+ */
+__attribute__((target("avx2")))
+static size_t hammingAvx2( const unsigned char * a, const unsigned char * b, size_t length ) {
+    const __m256i lut    = _mm256_setr_epi8( 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 );
+    const __m256i nibble = _mm256_set1_epi8( 0x0f );
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32 ) {
+        __m256i x = _mm256_xor_si256( _mm256_loadu_si256( reinterpret_cast<const __m256i *>( a + i ) ),
+                                      _mm256_loadu_si256( reinterpret_cast<const __m256i *>( b + i ) ) );
+        __m256i count = _mm256_add_epi8( _mm256_shuffle_epi8( lut, _mm256_and_si256( x, nibble ) ),
+                                         _mm256_shuffle_epi8( lut, _mm256_and_si256( _mm256_srli_epi16( x, 4 ), nibble ) ) );
+        sum = _mm256_add_epi64( sum, _mm256_sad_epu8( count, _mm256_setzero_si256() ) );
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256( reinterpret_cast<__m256i *>( lanes ), sum );
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + hammingScalar( a + i, b + i, length - i );
+}
+
+static bool avx2Supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+}
+
+static size_t ( *hammingKernel )( const unsigned char *, const unsigned char *, size_t ) = avx2Supported() ? hammingAvx2 : hammingScalar;
+
+bool analysisUseAvx2( bool enable ) {
+    if ( enable && !avx2Supported() ) {
+        return false;
+    }
+    hammingKernel = enable ? hammingAvx2 : hammingScalar;
+    return true;
+}
+
+size_t hammingDistance( const unsigned char * a, const unsigned char * b, size_t length ) {
+    return hammingKernel( a, b, length );
+}
+
+KeyLengthEstimate estimateKeyLength( const Corpus & corpus, size_t maxPeriod ) {
+    size_t longest = 0;
+    for ( size_t m = 0; m < corpus.size(); m++ ) {
+        longest = std::max( longest, corpus.length( m ) );
+    }
+    size_t columns = std::min( longest, MAX_COLUMNS );
+    maxPeriod = std::min( maxPeriod, longest / 2 );
+
+    // Each message is read once, it feeds column histograms and is compared
+    // with itself at every period while it is still in cache
+    std::vector<unsigned> histogram( columns * 256, 0 );
+    std::vector<size_t> bits( maxPeriod + 1, 0 ), bytes( maxPeriod + 1, 0 );
+    KeyLengthEstimate estimate;
+    estimate.depth.assign( columns, 0 );
+    for ( size_t m = 0; m < corpus.size(); m++ ) {
+        const unsigned char * data = reinterpret_cast<const unsigned char *>( corpus.data( m ) );
+        size_t length = corpus.length( m );
+        for ( size_t p = 0; p < std::min( length, columns ); p++ ) {
+            histogram[p * 256 + data[p]]++;
+            estimate.depth[p]++;
+        }
+        for ( size_t period = 1; period <= maxPeriod && period < length; period++ ) {
+            bits[period]  += hammingKernel( data, data + period, length - period );
+            bytes[period] += length - period;
+        }
+    }
+
+    estimate.keystream = 0;
+    estimate.coincidence.assign( columns, 0 );
+    for ( size_t p = 0; p < columns; p++ ) {
+        size_t n = estimate.depth[p];
+        if ( n < 2 ) {
+            continue;
+        }
+        double pairs = 0;
+        for ( int c = 0; c < 256; c++ ) {
+            double count = histogram[p * 256 + c];
+            pairs += count * ( count - 1 );
+        }
+        estimate.coincidence[p] = 256 * pairs / ( static_cast<double>( n ) * ( n - 1 ) );
+        if ( n >= MIN_DEPTH && estimate.coincidence[p] >= MIN_COINCIDENCE ) {
+            estimate.keystream = p + 1;
+        }
+    }
+    if ( estimate.keystream == columns ) {
+        estimate.keystream = longest;
+    }
+
+    // Smallest period clearly below the mean, its multiples are low as well
+    estimate.period = 0;
+    estimate.distance.assign( maxPeriod + 1, 0 );
+    double mean = 0;
+    size_t periods = 0;
+    for ( size_t period = 1; period <= maxPeriod; period++ ) {
+        if ( bytes[period] ) {
+            estimate.distance[period] = static_cast<double>( bits[period] ) / bytes[period];
+            mean += estimate.distance[period];
+            periods++;
+        }
+    }
+    mean = periods ? mean / periods : 0;
+    for ( size_t period = 1; period <= maxPeriod && periods > 1; period++ ) {
+        if ( bytes[period] && estimate.distance[period] < MAX_DISTANCE * mean ) {
+            estimate.period = period;
+            break;
+        }
+    }
+    return estimate;
+}
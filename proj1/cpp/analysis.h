@@ -0,0 +1,42 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <vector>
+#include "corpus.h"
+
+/*
+ * Key length suggested by corpus statistics
+ */
+struct KeyLengthEstimate {
+    size_t              keystream;   // columns that still look encrypted by one shared keystream
+    size_t              period;      // period of key repeating inside messages, 0 when none
+    std::vector<double> coincidence; // index of coincidence of every column, 1 is random
+    std::vector<size_t> depth;       // messages covering every column
+    std::vector<double> distance;    // bits per byte differing at distance 1..max period, 4 is random
+
+    /*
+     * Length messages are truncated to
+     */
+    size_t length() const { return period ? period : keystream; }
+};
+
+/*
+ * Runs over the corpus once. Column histograms give index of coincidence
+ * across messages, the keystream ends after the last column that is deep
+ * enough and clearly above random. For every candidate period each message
+ * is compared with itself shifted by it, normalized Hamming distance well
+ * below random means the key repeats.
+ */
+KeyLengthEstimate estimateKeyLength( const Corpus & corpus, size_t maxPeriod = 512 );
+
+/*
+ * Number of differing bits of a and b, length bytes each
+ */
+size_t hammingDistance( const unsigned char * a, const unsigned char * b, size_t length );
+
+/*
+ * Selects AVX2 kernel when available, returns false when forced but unsupported
+ */
+bool analysisUseAvx2( bool enable );
+
+#endif
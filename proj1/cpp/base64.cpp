@@ -27,96 +27,308 @@
 
    René Nyffenegger rene.nyffenegger@adp-gmbh.ch
 
+   Altered source version: the character by character codec was replaced
+   by 256 entry lookup tables, preallocated output, strict validation and
+   SSSE3/AVX2 decoding selected at runtime. The vectorized decoder follows
+   the nibble lookup approach described by Wojciech Muła.
+
 */
 
 #include "base64.h"
-#include <iostream>
+#include <immintrin.h>
+#include <stdint.h>
 
-static const std::string base64_chars = 
+static const char base64_chars[] =
              "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
              "abcdefghijklmnopqrstuvwxyz"
              "0123456789+/";
 
+// 0xff marks characters outside of the alphabet, '=' included
+struct decode_table {
+  unsigned char value[256];
 
-static inline bool is_base64(unsigned char c) {
-  return (isalnum(c) || (c == '+') || (c == '/'));
+  decode_table() {
+    for (int i = 0; i < 256; i++)
+      value[i] = 0xff;
+    for (int i = 0; i < 64; i++)
+      value[static_cast<unsigned char>(base64_chars[i])] = i;
+  }
+};
+
+static const decode_table table;
+
+// Decodes full quartets, returns how many were decoded before the first one
+// containing a character outside of the alphabet. Writes at most 3 * quartets bytes.
+typedef size_t (*decode_fn)(const unsigned char* in, size_t quartets, unsigned char* out);
+
+static size_t decode_scalar(const unsigned char* in, size_t quartets, unsigned char* out) {
+  for (size_t q = 0; q < quartets; q++, in += 4, out += 3) {
+    uint32_t a = table.value[in[0]];
+    uint32_t b = table.value[in[1]];
+    uint32_t c = table.value[in[2]];
+    uint32_t d = table.value[in[3]];
+    if ((a | b | c | d) & 0x80)
+      return q;
+    uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+    out[0] = v >> 16;
+    out[1] = v >> 8;
+    out[2] = v;
+  }
+  return quartets;
 }
 
-std::string base64_encode(char const* bytes_to_encode, unsigned int in_len) {
-  std::string ret;
-  int i = 0;
-  int j = 0;
-  unsigned char char_array_3[3];
-  unsigned char char_array_4[4];
-
-  while (in_len--) {
-    char_array_3[i++] = *(bytes_to_encode++);
-    if (i == 3) {
-      char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-      char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-      char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-      char_array_4[3] = char_array_3[2] & 0x3f;
-
-      for(i = 0; (i <4) ; i++)
-        ret += base64_chars[char_array_4[i]];
-      i = 0;
-    }
+__attribute__((target("ssse3")))
+static size_t decode_ssse3(const unsigned char* in, size_t quartets, unsigned char* out) {
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2f);
+  const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+  size_t done = 0;
+  // 16 bytes are stored for 12 decoded ones, keep the spare 4 inside of the output
+  while (quartets - done >= 6) {
+    __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+    __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+    __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xffff)
+      break;
+    __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+    __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    str = _mm_add_epi8(str, roll);
+    __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+    merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(merged, pack));
+    in += 16;
+    out += 12;
+    done += 4;
+  }
+  return done + decode_scalar(in, quartets - done, out);
+}
+
+__attribute__((target("avx2")))
+static size_t decode_avx2(const unsigned char* in, size_t quartets, unsigned char* out) {
+  const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                          0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                                          0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                          0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                          0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                          0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                          0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+  const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+  size_t done = 0;
+  // 32 bytes are stored for 24 decoded ones, keep the spare 8 inside of the output
+  while (quartets - done >= 11) {
+    __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+    __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+    __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+    __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    if (!_mm256_testz_si256(lo, hi))
+      break;
+    __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+    __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+    str = _mm256_add_epi8(str, roll);
+    __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+    merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    merged = _mm256_shuffle_epi8(merged, pack);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permutevar8x32_epi32(merged, lanes));
+    in += 32;
+    out += 24;
+    done += 8;
   }
+  return done + decode_ssse3(in, quartets - done, out);
+}
 
-  if (i)
-  {
-    for(j = i; j < 3; j++)
-      char_array_3[j] = '\0';
+static base64_impl best_impl() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return BASE64_AVX2;
+  if (__builtin_cpu_supports("ssse3"))
+    return BASE64_SSSE3;
+  return BASE64_SCALAR;
+}
 
-    char_array_4[0] = ( char_array_3[0] & 0xfc) >> 2;
-    char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-    char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+static base64_impl current_impl = best_impl();
+static decode_fn decode_quartets = current_impl == BASE64_AVX2 ? decode_avx2 :
+                                   current_impl == BASE64_SSSE3 ? decode_ssse3 : decode_scalar;
+
+bool base64_set_impl(base64_impl impl) {
+  base64_impl best = best_impl();
+  if (impl == BASE64_AUTO)
+    impl = best;
+  if (impl > best)
+    return false;
+  current_impl = impl;
+  decode_quartets = impl == BASE64_AVX2 ? decode_avx2 : impl == BASE64_SSSE3 ? decode_ssse3 : decode_scalar;
+  return true;
+}
 
-    for (j = 0; (j < i + 1); j++)
-      ret += base64_chars[char_array_4[j]];
+base64_impl base64_get_impl() {
+  return current_impl;
+}
 
-    while((i++ < 3))
-      ret += '=';
+size_t base64_encode(char const* bytes_to_encode, size_t in_len, char* out) {
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(bytes_to_encode);
+  size_t i = 0;
+  for (; i + 3 <= in_len; i += 3, out += 4) {
+    uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+    out[0] = base64_chars[v >> 18];
+    out[1] = base64_chars[(v >> 12) & 0x3f];
+    out[2] = base64_chars[(v >> 6) & 0x3f];
+    out[3] = base64_chars[v & 0x3f];
+  }
 
+  if (i < in_len) {
+    uint32_t v = in[i] << 16;
+    if (i + 1 < in_len)
+      v |= in[i + 1] << 8;
+    out[0] = base64_chars[v >> 18];
+    out[1] = base64_chars[(v >> 12) & 0x3f];
+    out[2] = i + 1 < in_len ? base64_chars[(v >> 6) & 0x3f] : '=';
+    out[3] = '=';
   }
 
+  return base64_encode_bound(in_len);
+}
+
+std::string base64_encode(char const* bytes_to_encode, unsigned int in_len) {
+  std::string ret(base64_encode_bound(in_len), '=');
+  if (in_len)
+    base64_encode(bytes_to_encode, in_len, &ret[0]);
   return ret;
+}
 
+// Decodes up to three leftover characters the way the original decoder did
+static size_t decode_tail(const unsigned char* part, size_t count, unsigned char* out) {
+  if (count < 2)
+    return 0;
+  out[0] = (part[0] << 2) | (part[1] >> 4);
+  if (count < 3)
+    return 1;
+  out[1] = (part[1] << 4) | (part[2] >> 2);
+  return 2;
 }
 
 std::string base64_decode(std::string const& encoded_string) {
   size_t in_len = encoded_string.size();
-  int i = 0;
-  int j = 0;
-  int in_ = 0;
-  unsigned char char_array_4[4], char_array_3[3];
-  std::string ret;
-
-  while (in_len-- && ( encoded_string[in_] != '=') && is_base64(encoded_string[in_])) {
-    char_array_4[i++] = encoded_string[in_]; in_++;
-    if (i ==4) {
-      for (i = 0; i <4; i++)
-        char_array_4[i] = base64_chars.find(char_array_4[i]) & 0xff;
-
-      char_array_3[0] = ( char_array_4[0] << 2       ) + ((char_array_4[1] & 0x30) >> 4);
-      char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-      char_array_3[2] = ((char_array_4[2] & 0x3) << 6) +   char_array_4[3];
-
-      for (i = 0; (i < 3); i++)
-        ret += char_array_3[i];
-      i = 0;
-    }
+  std::string ret(in_len / 4 * 3 + 3, '\0');
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(encoded_string.data());
+  unsigned char* out = reinterpret_cast<unsigned char*>(&ret[0]);
+
+  // Decoding stops at the first '=' or character outside of the alphabet
+  size_t quartets = decode_quartets(in, in_len / 4, out);
+  size_t pos = quartets * 4;
+  size_t written = quartets * 3;
+  unsigned char part[4];
+  size_t count = 0;
+  while (pos < in_len && count < 4 && !(table.value[in[pos]] & 0x80))
+    part[count++] = table.value[in[pos++]];
+  written += decode_tail(part, count, out + written);
+
+  ret.resize(written);
+  return ret;
+}
+
+bool base64_decode(std::string const& s, std::string& out) {
+  size_t len = s.size();
+  if (len % 4) {
+    return false;
+  }
+  size_t pad = 0;
+  if (len && s[len - 1] == '=')
+    pad = s[len - 2] == '=' ? 2 : 1;
+  size_t full = len / 4 - (pad ? 1 : 0);
+
+  out.resize(full * 3 + (pad ? 3 - pad : 0));
+  if (out.empty())
+    return true;
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(s.data());
+  unsigned char* dst = reinterpret_cast<unsigned char*>(&out[0]);
+  if (decode_quartets(in, full, dst) != full)
+    return false;
+  if (!pad)
+    return true;
+
+  in += full * 4;
+  unsigned char part[3];
+  for (size_t i = 0; i < 4 - pad; i++) {
+    part[i] = table.value[in[i]];
+    if (part[i] & 0x80)
+      return false;
   }
+  // Bits that do not make a whole byte have to be zero
+  if ((pad == 1 && (part[2] & 0x03)) || (pad == 2 && (part[1] & 0x0f)))
+    return false;
+  decode_tail(part, 4 - pad, dst + full * 3);
+  return true;
+}
+
+base64_decoder::base64_decoder() {
+  reset();
+}
 
-  if (i) {
-    for (j = 0; j < i; j++)
-      char_array_4[j] = base64_chars.find(char_array_4[j]) & 0xff;
+void base64_decoder::reset() {
+  pending_count_ = 0;
+  padding_ = 0;
+}
 
-    char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-    char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+bool base64_decoder::update(char const* input, size_t len, char* output, size_t& written) {
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+  const unsigned char* end = in + len;
+  unsigned char* out = reinterpret_cast<unsigned char*>(output);
+  written = 0;
+
+  while (in < end) {
+    // Whole quartets go through the vectorized decoder
+    if (!pending_count_ && !padding_) {
+      size_t quartets = decode_quartets(in, (end - in) / 4, out + written);
+      in += quartets * 4;
+      written += quartets * 3;
+      if (in == end)
+        break;
+    }
 
-    for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
+    unsigned char value = table.value[*in];
+    if (*in == '=' && pending_count_ + padding_ >= 2 && pending_count_ + padding_ < 4) {
+      padding_++;
+    }
+    else if ((value & 0x80) || padding_) {
+      return false;
+    }
+    else {
+      pending_[pending_count_++] = value;
+      if (pending_count_ == 4) {
+        out[written++] = (pending_[0] << 2) | (pending_[1] >> 4);
+        out[written++] = (pending_[1] << 4) | (pending_[2] >> 2);
+        out[written++] = (pending_[2] << 6) | pending_[3];
+        pending_count_ = 0;
+      }
+    }
+    in++;
   }
+  return true;
+}
 
-  return ret;
+bool base64_decoder::finish(char* output, size_t& written) {
+  unsigned char* out = reinterpret_cast<unsigned char*>(output);
+  written = decode_tail(pending_, pending_count_, out);
+  bool valid = pending_count_ + padding_ == (pending_count_ ? 4 : 0);
+  if (valid && pending_count_ == 3)
+    valid = !(pending_[2] & 0x03);
+  else if (valid && pending_count_ == 2)
+    valid = !(pending_[1] & 0x0f);
+  reset();
+  return valid;
 }
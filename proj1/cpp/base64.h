@@ -2,13 +2,63 @@
 //  base64 encoding and decoding with C++.
 //  Version: 1.01.00
 //
+//  Altered: table driven codec with SSSE3/AVX2 decoding, see base64.cpp.
+//
 
 #ifndef BASE64_H_C0CE2A47_D10E_42C9_A27C_C883944E704A
 #define BASE64_H_C0CE2A47_D10E_42C9_A27C_C883944E704A
 
+#include <cstddef>
 #include <string>
 
 std::string base64_encode(char const* , unsigned int len);
+
+// Encodes len bytes to out, which has to have room for
+// base64_encode_bound(len) characters. Returns number of characters written.
+size_t base64_encode(char const* in, size_t len, char* out);
+
+inline size_t base64_encode_bound(size_t len) {
+  return (len + 2) / 3 * 4;
+}
 std::string base64_decode(std::string const& s);
 
+// Strict variant, fails on characters outside of the alphabet, misplaced
+// padding, length that is not a multiple of four and non zero padding bits.
+bool base64_decode(std::string const& s, std::string& out);
+
+// Incremental decoder of one base64 stream writing into caller provided
+// buffers. Partial quartets are carried across calls, so the input can be
+// split into chunks at any position.
+class base64_decoder {
+ public:
+  base64_decoder();
+
+  // Decodes len characters to out, which has to have room for
+  // base64_decode_bound(len) bytes. Returns false on character outside of
+  // the alphabet or misplaced padding, written holds bytes decoded before it.
+  bool update(char const* in, size_t len, char* out, size_t& written);
+
+  // Flushes the last partial quartet (at most 2 bytes) and resets the
+  // decoder. Returns false when the stream ended in the middle of a quartet.
+  bool finish(char* out, size_t& written);
+
+  void reset();
+
+ private:
+  unsigned char pending_[4];
+  size_t pending_count_;
+  size_t padding_;
+};
+
+inline size_t base64_decode_bound(size_t len) {
+  return (len + 3) / 4 * 3;
+}
+
+// Decoder implementation, BASE64_AUTO picks the best one the CPU supports.
+enum base64_impl { BASE64_AUTO, BASE64_SCALAR, BASE64_SSSE3, BASE64_AVX2 };
+
+// Returns false when the CPU does not support requested implementation.
+bool base64_set_impl(base64_impl impl);
+base64_impl base64_get_impl();
+
 #endif /* BASE64_H_C0CE2A47_D10E_42C9_A27C_C883944E704A */
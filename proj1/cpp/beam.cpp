@@ -0,0 +1,324 @@
+#include "beam.h"
+#include <algorithm>
+#include <cstring>
+
+static const char ALPHABET[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+static const size_t LETTERS  = sizeof( ALPHABET ) - 1;
+
+// Wordlists are never complete, a few broken words are tolerated and cost score
+static const size_t MISS_SLACK   = 2;
+static const size_t MISS_RATIO   = 10;  // one more per this many whole words
+static const double MISS_PENALTY = 8.0; // log probability per broken word
+
+/*
+ * Scoring state of one message for one partial crib. Valid bytes are the
+ * ones before the end of the message, they always form a prefix of the crib.
+ */
+struct Context {
+    float         score;
+    unsigned      valid;
+    unsigned char head[2]; // first two plaintext bytes
+    unsigned char tail[2]; // classes of last two valid bytes
+    uint32_t      word;    // automaton state after last valid byte
+    unsigned      run;     // letters since last boundary
+    bool          bounded; // run has a boundary on its left
+    bool          broken;  // run already counted as a miss
+};
+
+/*
+ * Partial crib, text and contexts live in arenas owned by Beam
+ */
+struct State {
+    size_t start;
+    size_t length;
+    double score;
+    size_t count;
+    size_t words;  // whole dictionary words in all messages
+    size_t misses; // broken words in all messages
+};
+
+/*
+ * One way to extend parent state
+ */
+struct Candidate {
+    size_t parent;
+    size_t letter;
+    bool   left;
+    double score;
+    size_t count;
+    size_t words;
+    size_t misses;
+
+    double mean() const { return count ? ( score - MISS_PENALTY * misses ) / count : 0; }
+};
+
+/*
+ * Preallocated generation of states
+ */
+struct Beam {
+    std::vector<State>   states;
+    std::vector<char>    text;
+    std::vector<Context> contexts;
+    size_t               size;
+
+    Beam( size_t width, size_t limit, size_t messages )
+        : states( width ), text( width * limit ), contexts( width * messages ), size( 0 ) {}
+};
+
+/*
+ * Checks byte appended on the right. A run of letters after a boundary has
+ * to stay the start of some word and a boundary has to end a whole word,
+ * miss is reported once per broken run.
+ */
+static void checkWord( const WordAutomaton & words, const Context & context, unsigned char c, bool & miss, bool & whole ) {
+    int symbol = words.symbol( c );
+    miss  = false;
+    whole = false;
+    if ( !context.bounded ) {
+        return;
+    }
+    if ( symbol == WordAutomaton::BOUNDARY ) {
+        whole = context.run && !context.broken && words.word( context.word ) && words.depth( context.word ) == context.run;
+        miss  = context.run && !context.broken && !whole;
+    }
+    else {
+        miss = !context.broken && words.depth( words.next( context.word, symbol ) ) != context.run + 1;
+    }
+}
+
+static void advanceWord( const WordAutomaton & words, Context & context, unsigned char c ) {
+    int symbol = words.symbol( c );
+    if ( symbol == WordAutomaton::BOUNDARY ) {
+        context.word    = WordAutomaton::ROOT;
+        context.run     = 0;
+        context.bounded = true;
+        context.broken  = false;
+        return;
+    }
+    bool miss, whole;
+    checkWord( words, context, c, miss, whole );
+    context.broken = context.broken || miss;
+    context.word   = words.next( context.word, symbol );
+    context.run++;
+}
+
+/*
+ * Score change of all messages after adding letter, false when some
+ * message stops being readable. With words, whole words and broken words
+ * the letter makes are counted.
+ */
+static bool tryLetter( const ColumnMatrix & matrix, const LanguageModel & model, const WordAutomaton * words, const State & state,
+                       const Context * contexts, char letter, bool left, double & delta, size_t & added, size_t & wholes,
+                       size_t & misses ) {
+    const int S = LanguageModel::START;
+    size_t position = left ? state.start - 1 : state.start + state.length;
+    const unsigned char * row = matrix.column( position );
+    const unsigned char * pad = matrix.padding( position );
+    delta  = 0;
+    added  = 0;
+    wholes = 0;
+    misses = 0;
+    for ( size_t m = 0; m < matrix.messages(); m++ ) {
+        if ( pad[m] ) {
+            continue;
+        }
+        unsigned char c = row[m] ^ letter;
+        if ( !cribReadable( c ) ) {
+            return false;
+        }
+        const Context & context = contexts[m];
+        if ( words && !left ) {
+            bool miss, whole;
+            checkWord( *words, context, c, miss, whole );
+            wholes += whole;
+            misses += miss;
+        }
+        if ( left ) {
+            // New first byte shifts contexts of the two bytes after it
+            delta += model.next( S, S, c );
+            if ( context.valid > 0 ) {
+                unsigned char h0 = context.head[0];
+                delta += model.next( S, model.classOf( c ), h0 ) - model.next( S, S, h0 );
+                if ( context.valid > 1 ) {
+                    unsigned char h1 = context.head[1];
+                    delta += model.next( model.classOf( c ), model.classOf( h0 ), h1 ) - model.next( S, model.classOf( h0 ), h1 );
+                }
+            }
+        }
+        else {
+            delta += model.next( context.tail[0], context.tail[1], c );
+        }
+        added++;
+    }
+    return true;
+}
+
+static void applyLetter( const ColumnMatrix & matrix, const LanguageModel & model, const WordAutomaton * words, const State & state,
+                         Context * contexts, char letter, bool left ) {
+    const int S = LanguageModel::START;
+    size_t position = left ? state.start - 1 : state.start + state.length;
+    const unsigned char * row = matrix.column( position );
+    const unsigned char * pad = matrix.padding( position );
+    for ( size_t m = 0; m < matrix.messages(); m++ ) {
+        if ( pad[m] ) {
+            continue;
+        }
+        unsigned char c = row[m] ^ letter;
+        Context & context = contexts[m];
+        if ( words && ( !left || context.valid == 0 ) ) {
+            advanceWord( *words, context, c );
+        }
+        if ( left ) {
+            if ( context.valid > 0 ) {
+                unsigned char h0 = context.head[0];
+                context.score += model.next( S, model.classOf( c ), h0 ) - model.next( S, S, h0 );
+                if ( context.valid > 1 ) {
+                    unsigned char h1 = context.head[1];
+                    context.score += model.next( model.classOf( c ), model.classOf( h0 ), h1 ) - model.next( S, model.classOf( h0 ), h1 );
+                }
+            }
+            context.score  += model.next( S, S, c );
+            context.head[1] = context.head[0];
+            context.head[0] = c;
+            if ( context.valid == 0 ) {
+                context.tail[1] = model.classOf( c );
+            }
+            else if ( context.valid == 1 ) {
+                context.tail[0] = model.classOf( c );
+            }
+        }
+        else {
+            context.score += model.next( context.tail[0], context.tail[1], c );
+            if ( context.valid < 2 ) {
+                context.head[context.valid] = c;
+            }
+            context.tail[0] = context.tail[1];
+            context.tail[1] = model.classOf( c );
+        }
+        context.valid++;
+    }
+}
+
+std::string beamExtend( const ColumnMatrix & matrix, const LanguageModel & model, const std::string & crib,
+                        size_t & offset, size_t limit, size_t width, const WordAutomaton * words ) {
+    const size_t messages = matrix.messages();
+    limit = std::max( limit, crib.size() );
+    width = std::max<size_t>( width, 1 );
+    if ( crib.empty() || offset + crib.size() > matrix.positions() ) {
+        return crib;
+    }
+
+    Beam current( width, limit, messages ), next( width, limit, messages );
+    std::vector<Candidate> candidates( width * LETTERS * 2 );
+
+    // Initial state is the crib itself, appended one letter at a time
+    State & first = current.states[0];
+    first.start  = offset;
+    first.length = 0;
+    for ( size_t m = 0; m < messages; m++ ) {
+        Context & context = current.contexts[m];
+        context.score = 0;
+        context.valid = 0;
+        context.tail[0] = context.tail[1] = LanguageModel::START;
+        context.word    = WordAutomaton::ROOT;
+        context.run     = 0;
+        context.bounded = offset == 0; // start of message is a boundary
+        context.broken  = false;
+    }
+    for ( char letter : crib ) {
+        applyLetter( matrix, model, words, first, current.contexts.data(), letter, false );
+        first.length++;
+    }
+    std::memcpy( current.text.data(), crib.data(), crib.size() );
+    first.score  = 0;
+    first.count  = 0;
+    first.words  = 0;
+    first.misses = 0;
+    for ( size_t m = 0; m < messages; m++ ) {
+        first.score += current.contexts[m].score;
+        first.count += current.contexts[m].valid;
+    }
+    current.size = 1;
+
+    while ( current.states[0].length < limit ) {
+        size_t used = 0;
+        for ( size_t s = 0; s < current.size; s++ ) {
+            const State & state = current.states[s];
+            const Context * contexts = current.contexts.data() + s * messages;
+            for ( int side = 0; side < 2; side++ ) {
+                bool left = side == 1;
+                if ( left ? state.start == 0 : state.start + state.length >= matrix.positions() ) {
+                    continue;
+                }
+                for ( size_t l = 0; l < LETTERS; l++ ) {
+                    double delta;
+                    size_t added, wholes, misses;
+                    if ( !tryLetter( matrix, model, words, state, contexts, ALPHABET[l], left, delta, added, wholes, misses ) ||
+                         state.misses + misses > MISS_SLACK + ( state.words + wholes ) / MISS_RATIO ) {
+                        continue;
+                    }
+                    Candidate & candidate = candidates[used++];
+                    candidate.parent = s;
+                    candidate.letter = l;
+                    candidate.left   = left;
+                    candidate.score  = state.score + delta;
+                    candidate.count  = state.count + added;
+                    candidate.words  = state.words + wholes;
+                    candidate.misses = state.misses + misses;
+                }
+            }
+        }
+        if ( used == 0 ) {
+            break;
+        }
+
+        // Stable order keeps greedy preference on ties: right side, alphabet order
+        std::stable_sort( candidates.begin(), candidates.begin() + used, []( const Candidate & a, const Candidate & b ) {
+            return a.mean() > b.mean();
+        } );
+
+        // The same crib is reached by extending left then right and right then
+        // left, only its best scored copy is kept
+        size_t keep = 0;
+        for ( size_t c = 0; c < used && keep < width; c++ ) {
+            const Candidate & candidate = candidates[c];
+            const State & parent = current.states[candidate.parent];
+            char * text = next.text.data() + keep * limit;
+            const char * from = current.text.data() + candidate.parent * limit;
+            if ( candidate.left ) {
+                text[0] = ALPHABET[candidate.letter];
+                std::memcpy( text + 1, from, parent.length );
+            }
+            else {
+                std::memcpy( text, from, parent.length );
+                text[parent.length] = ALPHABET[candidate.letter];
+            }
+            size_t start = parent.start - candidate.left;
+            bool duplicate = false;
+            for ( size_t k = 0; k < keep && !duplicate; k++ ) {
+                duplicate = next.states[k].start == start && std::memcmp( next.text.data() + k * limit, text, parent.length + 1 ) == 0;
+            }
+            if ( duplicate ) {
+                continue;
+            }
+
+            State & state = next.states[keep];
+            std::memcpy( next.contexts.data() + keep * messages, current.contexts.data() + candidate.parent * messages,
+                         messages * sizeof( Context ) );
+            applyLetter( matrix, model, words, parent, next.contexts.data() + keep * messages, ALPHABET[candidate.letter], candidate.left );
+            state.start  = start;
+            state.length = parent.length + 1;
+            state.score  = candidate.score;
+            state.count  = candidate.count;
+            state.words  = candidate.words;
+            state.misses = candidate.misses;
+            keep++;
+        }
+        next.size = keep;
+        std::swap( current, next );
+    }
+
+    const State & best = current.states[0];
+    offset = best.start;
+    return std::string( current.text.data(), best.length );
+}
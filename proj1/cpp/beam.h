@@ -0,0 +1,24 @@
+#ifndef BEAM_H
+#define BEAM_H
+
+#include <string>
+#include <vector>
+#include "cribdrag.h"
+#include "score.h"
+#include "wordlist.h"
+
+/*
+ * Extends crib placed at offset one character per step, to the right and to
+ * the left, keeping width best partial cribs. Every added character has to
+ * keep all messages readable as testReadable() demands, candidates are
+ * ranked by mean log probability of model over all messages. Only the newly
+ * added column is scored, per-message contexts are carried in the state.
+ * With words, every letter added on the right takes one automaton step per
+ * message. Words it breaks lower the score and more than a few per ten
+ * whole words prune the candidate.
+ * Returns the longest best crib, offset is moved to its start.
+ */
+std::string beamExtend( const ColumnMatrix & matrix, const LanguageModel & model, const std::string & crib,
+                        size_t & offset, size_t limit, size_t width, const WordAutomaton * words = nullptr );
+
+#endif
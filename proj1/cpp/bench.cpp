@@ -0,0 +1,505 @@
+/*
+ * Benchmarks of breaker building blocks, run as ./bench [ megabytes ]
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "base64.h"
+#include "corpus.h"
+#include "cribdrag.h"
+#include "xorstream.h"
+#include "analysis.h"
+#include "wordlist.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<size_t> allocations( 0 );
+
+void * operator new( size_t size ) {
+    allocations++;
+    void * ptr = std::malloc( size ? size : 1 );
+    if ( !ptr ) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete( void * ptr ) noexcept {
+    std::free( ptr );
+}
+
+static double seconds( Clock::time_point start ) {
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+/*
+ * Original character by character decoder, kept as reference
+ */
+std::string legacyDecode( std::string const & encoded ) {
+    static const std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t length = encoded.size(), in = 0;
+    int i = 0;
+    unsigned char quartet[4], triple[3];
+    std::string ret;
+    while ( length-- && encoded[in] != '=' && ( std::isalnum( encoded[in] ) || encoded[in] == '+' || encoded[in] == '/' ) ) {
+        quartet[i++] = encoded[in++];
+        if ( i == 4 ) {
+            for ( i = 0; i < 4; i++ ) {
+                quartet[i] = chars.find( quartet[i] ) & 0xff;
+            }
+            triple[0] = ( quartet[0] << 2 ) + ( ( quartet[1] & 0x30 ) >> 4 );
+            triple[1] = ( ( quartet[1] & 0xf ) << 4 ) + ( ( quartet[2] & 0x3c ) >> 2 );
+            triple[2] = ( ( quartet[2] & 0x3 ) << 6 ) + quartet[3];
+            for ( i = 0; i < 3; i++ ) {
+                ret += triple[i];
+            }
+            i = 0;
+        }
+    }
+    if ( i ) {
+        for ( int j = 0; j < i; j++ ) {
+            quartet[j] = chars.find( quartet[j] ) & 0xff;
+        }
+        triple[0] = ( quartet[0] << 2 ) + ( ( quartet[1] & 0x30 ) >> 4 );
+        triple[1] = ( ( quartet[1] & 0xf ) << 4 ) + ( ( quartet[2] & 0x3c ) >> 2 );
+        for ( int j = 0; j < i - 1; j++ ) {
+            ret += triple[j];
+        }
+    }
+    return ret;
+}
+
+/*
+ * Compares every decoder with the original one on random and corrupted inputs
+ */
+bool verifyBase64() {
+    std::mt19937 random( 42 );
+    const base64_impl impls[] = { BASE64_SCALAR, BASE64_SSSE3, BASE64_AVX2 };
+    for ( int round = 0; round < 2000; round++ ) {
+        std::string data( random() % 300, '\0' );
+        for ( char & c : data ) {
+            c = random();
+        }
+        std::string encoded = base64_encode( data.c_str(), data.size() );
+        if ( round % 3 == 1 && !encoded.empty() ) {
+            encoded[random() % encoded.size()] = "=-*\n\xc3"[random() % 5];
+        }
+        std::string reference = legacyDecode( encoded );
+        for ( base64_impl impl : impls ) {
+            if ( !base64_set_impl( impl ) ) {
+                continue;
+            }
+            std::string strict;
+            bool valid = base64_decode( encoded, strict );
+            if ( base64_decode( encoded ) != reference || ( round % 3 != 1 && ( !valid || strict != data ) ) ) {
+                std::cerr << "base64 mismatch, implementation " << impl << ", round " << round << std::endl;
+                return false;
+            }
+
+            // Same stream fed in random chunks
+            base64_decoder decoder;
+            std::vector<char> out( base64_decode_bound( encoded.size() ) + 3 );
+            size_t total = 0, written = 0;
+            bool ok = true;
+            for ( size_t pos = 0; pos < encoded.size() && ok; ) {
+                size_t chunk = std::min<size_t>( random() % 40, encoded.size() - pos );
+                ok = decoder.update( encoded.data() + pos, chunk, out.data() + total, written );
+                total += written;
+                pos += chunk;
+            }
+            ok = ok && decoder.finish( out.data() + total, written );
+            total += written;
+            if ( ok != valid || ( valid && std::string( out.data(), total ) != strict ) ) {
+                std::cerr << "base64 stream mismatch, implementation " << impl << ", round " << round << std::endl;
+                return false;
+            }
+        }
+    }
+    base64_set_impl( BASE64_AUTO );
+    return true;
+}
+
+void benchBase64( size_t megabytes ) {
+    std::mt19937 random( 42 );
+    std::string data( megabytes << 20, '\0' );
+    for ( char & c : data ) {
+        c = random();
+    }
+    std::string encoded = base64_encode( data.c_str(), data.size() );
+
+    // Corpus sized lines, 331 bytes is one message of proj1/messages.txt
+    std::vector<std::string> lines;
+    for ( size_t i = 0; i + 331 <= data.size(); i += 331 ) {
+        lines.push_back( base64_encode( data.c_str() + i, 331 ) );
+    }
+
+    std::cout << "base64, " << megabytes << " MiB of random data" << std::endl;
+    std::cout << "operation                 GB/s" << std::endl;
+    std::cout << std::fixed << std::setprecision( 3 );
+
+    Clock::time_point start = Clock::now();
+    std::string result = legacyDecode( encoded );
+    std::cout << std::left << std::setw( 22 ) << "decode original" << std::right << std::setw( 9 ) << encoded.size() / seconds( start ) / 1e9 << std::endl;
+
+    const char * names[] = { "", "decode scalar", "decode ssse3", "decode avx2" };
+    for ( base64_impl impl : { BASE64_SCALAR, BASE64_SSSE3, BASE64_AVX2 } ) {
+        if ( !base64_set_impl( impl ) ) {
+            continue;
+        }
+        start = Clock::now();
+        result = base64_decode( encoded );
+        std::cout << std::left << std::setw( 22 ) << names[impl] << std::right << std::setw( 9 ) << encoded.size() / seconds( start ) / 1e9 << std::endl;
+    }
+    base64_set_impl( BASE64_AUTO );
+
+    start = Clock::now();
+    for ( const std::string & line : lines ) {
+        result = base64_decode( line );
+    }
+    std::cout << std::left << std::setw( 22 ) << "decode per line" << std::right << std::setw( 9 ) << lines.size() * lines[0].size() / seconds( start ) / 1e9 << std::endl;
+
+    start = Clock::now();
+    result = base64_encode( data.c_str(), data.size() );
+    std::cout << std::left << std::setw( 22 ) << "encode" << std::right << std::setw( 9 ) << data.size() / seconds( start ) / 1e9 << std::endl;
+}
+
+/*
+ * Decodes a corpus of base64 lines as getline + base64_decode + substr and
+ * as fixed size blocks fed to base64_decoder
+ */
+void benchStreaming( size_t megabytes ) {
+    std::mt19937 random( 7 );
+    std::string file;
+    std::string message( 344, '\0' );
+    while ( file.size() < ( megabytes << 20 ) ) {
+        for ( char & c : message ) {
+            c = random();
+        }
+        file += base64_encode( message.c_str(), message.size() ) + '\n';
+    }
+    double mb = file.size() / 1048576.0;
+
+    std::cout << "streaming decode, " << std::setprecision( 1 ) << mb << " MiB corpus" << std::endl;
+    std::cout << "operation                 ms/MiB   allocations/MiB" << std::endl;
+    std::cout << std::setprecision( 3 );
+
+    size_t before = allocations;
+    Clock::time_point start = Clock::now();
+    size_t total = 0;
+    {
+        std::istringstream input( file );
+        std::string line;
+        std::vector<std::string> lines;
+        while ( std::getline( input, line ) ) {
+            lines.push_back( line );
+        }
+        for ( std::string & l : lines ) {
+            l = base64_decode( l ).substr( 0, 331 );
+            total += l.size();
+        }
+    }
+    std::cout << std::left << std::setw( 22 ) << "per line strings" << std::right << std::setw( 10 ) << seconds( start ) * 1e3 / mb
+              << std::setw( 18 ) << ( allocations - before ) / mb << std::endl;
+
+    const size_t block = 64 << 10;
+    std::vector<char> arena( base64_decode_bound( file.size() ) );
+    before = allocations;
+    start  = Clock::now();
+    size_t streamed = 0, lineStart = 0, written = 0;
+    base64_decoder decoder;
+    for ( size_t offset = 0; offset < file.size(); offset += block ) {
+        const char * chunk = file.data() + offset;
+        size_t length = std::min( block, file.size() - offset );
+        for ( size_t i = 0; i < length; ) {
+            const char * newline = static_cast<const char *>( std::memchr( chunk + i, '\n', length - i ) );
+            size_t end = newline ? newline - chunk : length;
+            decoder.update( chunk + i, end - i, arena.data() + streamed, written );
+            streamed += written;
+            if ( newline ) {
+                decoder.finish( arena.data() + streamed, written );
+                streamed += written;
+                total -= std::min<size_t>( streamed - lineStart, 331 );
+                lineStart = streamed;
+            }
+            i = end + 1;
+        }
+    }
+    std::cout << std::left << std::setw( 22 ) << "streaming blocks" << std::right << std::setw( 10 ) << seconds( start ) * 1e3 / mb
+              << std::setw( 18 ) << ( allocations - before ) / mb << std::endl;
+    if ( total != 0 ) {
+        std::cerr << "streaming decode mismatch" << std::endl;
+    }
+}
+
+/*
+ * Writes many-time-pad corpus of readable messages under one random keystream
+ */
+void writeSyntheticCorpus( const std::string & filename, size_t messages, size_t length, unsigned seed ) {
+    // Messages are random slices of proj1/result.txt, random letters when it is missing
+    std::ifstream source( "../result.txt" );
+    std::string text, line;
+    while ( std::getline( source, line ) ) {
+        text += line + ' ';
+    }
+    if ( text.size() <= length ) {
+        text = "abcdefghijklmnopqrstuvwxyz      ABCDEFGHIJKLMNOPQRSTUVWXYZ.,";
+    }
+
+    std::mt19937 random( seed );
+    std::string key( length, '\0' ), message( length, '\0' );
+    for ( char & c : key ) {
+        c = random();
+    }
+    std::ofstream file( filename, std::ios::binary );
+    for ( size_t m = 0; m < messages; m++ ) {
+        size_t start = text.size() > length * 2 ? random() % ( text.size() - length ) : 0;
+        for ( size_t i = 0; i < length; i++ ) {
+            char c = text.size() > length * 2 ? text[start + i] : text[random() % text.size()];
+            message[i] = c ^ key[i];
+        }
+        file << base64_encode( message.c_str(), message.size() ) << '\n';
+    }
+}
+
+/*
+ * Crib drag loop of the original breaker, kept as reference
+ */
+std::vector<size_t> legacyCribDrag( const std::vector<std::string> & xored, const std::string & word ) {
+    size_t min = -1;
+    for ( const std::string & line : xored ) {
+        min = line.size() < min ? line.size() : min;
+    }
+    std::vector<size_t> offsets;
+    for ( size_t j = 0; j < min; j++ ) {
+        bool all = true;
+        for ( const std::string & line : xored ) {
+            std::string result = "";
+            for ( size_t i = 0, k = j; i < word.size() && k < line.size(); ) {
+                result += word[i++] ^ line[k++];
+            }
+            for ( const char & a : result ) {
+                if ( ( a < 'A' || a > 'Z' ) && ( a < 'a' || a > 'z' ) && a != '.' && a != ',' && a != ' ' ) {
+                    all = false;
+                }
+            }
+            if ( !all ) {
+                break;
+            }
+        }
+        if ( all ) {
+            offsets.push_back( j );
+        }
+    }
+    return offsets;
+}
+
+void benchCribDrag( size_t messages ) {
+    const std::string filename = "bench_corpus.tmp";
+    writeSyntheticCorpus( filename, messages, 331, 11 );
+    Corpus corpus;
+    corpus.load( filename );
+    std::remove( filename.c_str() );
+
+    const char * cribs[] = { "e", "a ", " the ", "ovat", "zz", "Hello world" };
+    std::cout << "crib drag, " << messages << " messages of 331 bytes" << std::endl;
+    std::cout << "kernel                    ms/crib   speedup" << std::endl;
+
+    std::vector<std::string> xored;
+    for ( size_t m = 0; m < corpus.size(); m++ ) {
+        std::string line;
+        for ( size_t i = 0; i < corpus.length( m ) && i < corpus.length( 0 ); i++ ) {
+            line += corpus.data( m )[i] ^ corpus.data( 0 )[i];
+        }
+        xored.push_back( line );
+    }
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::vector<size_t> > reference;
+    for ( const char * crib : cribs ) {
+        reference.push_back( legacyCribDrag( xored, crib ) );
+    }
+    double legacy = seconds( start ) * 1e3 / 6;
+    std::cout << std::left << std::setw( 22 ) << "original strings" << std::right << std::setw( 11 ) << legacy << std::setw( 10 ) << 1.0 << std::endl;
+
+    start = Clock::now();
+    ColumnMatrix matrix;
+    matrix.build( corpus, 0 );
+    double transpose = seconds( start ) * 1e3;
+    std::cout << std::left << std::setw( 22 ) << "transpose (once)" << std::right << std::setw( 11 ) << transpose << std::endl;
+
+    const char * names[] = { "column scalar", "column avx2" };
+    for ( int avx2 = 0; avx2 < 2; avx2++ ) {
+        if ( !cribDragUseAvx2( avx2 ) ) {
+            continue;
+        }
+        start = Clock::now();
+        for ( int i = 0; i < 6; i++ ) {
+            if ( cribDrag( matrix, cribs[i] ) != reference[i] ) {
+                std::cerr << "crib drag mismatch for '" << cribs[i] << "'" << std::endl;
+            }
+        }
+        double elapsed = seconds( start ) * 1e3 / 6;
+        std::cout << std::left << std::setw( 22 ) << names[avx2] << std::right << std::setw( 11 ) << elapsed << std::setw( 10 ) << legacy / elapsed << std::endl;
+    }
+    cribDragUseAvx2( true );
+}
+
+/*
+ * Encrypts a file of long lines with 331 byte key, the way encrypt() of
+ * breaker did it and with xorStream() using both kernels
+ */
+void benchXorStream( size_t megabytes ) {
+    std::mt19937 random( 11 );
+    std::string key( 331, '\0' );
+    for ( char & c : key ) {
+        c = random();
+    }
+    std::string text( 4096, '\0' );
+    std::ofstream messages( "bench_messages.txt", std::ios::binary );
+    for ( size_t written = 0; written < ( megabytes << 20 ); written += text.size() + 1 ) {
+        for ( char & c : text ) {
+            c = 'a' + random() % 26;
+        }
+        messages << text << '\n';
+    }
+    messages.close();
+    std::ofstream( "bench_key.bin", std::ios::binary ) << key;
+
+    // Both kernels have to agree on every phase and length
+    std::vector<unsigned char> input( 1000 ), scalar( 1000 ), avx2( 1000 );
+    for ( unsigned char & c : input ) {
+        c = random();
+    }
+    for ( size_t phase = 0; phase < 400; phase += 37 ) {
+        xorStreamUseAvx2( false );
+        xorCyclic( input.data(), input.size() - phase, reinterpret_cast<const unsigned char *>( key.data() ), key.size(), phase, scalar.data() );
+        if ( xorStreamUseAvx2( true ) ) {
+            xorCyclic( input.data(), input.size() - phase, reinterpret_cast<const unsigned char *>( key.data() ), key.size(), phase, avx2.data() );
+            if ( scalar != avx2 ) {
+                std::cerr << "xor kernel mismatch" << std::endl;
+            }
+        }
+    }
+
+    std::cout << "xor stream, " << megabytes << " MiB of 4 KiB messages, 331 byte key" << std::endl;
+    std::cout << "operation                 GB/s" << std::endl;
+    std::cout << std::fixed << std::setprecision( 3 );
+
+    // Legacy loop only encrypts the key long prefix of every line
+    Clock::time_point start = Clock::now();
+    std::ifstream lines( "bench_messages.txt" );
+    std::ofstream sink( "/dev/null" );
+    std::string line, result;
+    size_t total = 0;
+    while ( std::getline( lines, line ) ) {
+        for ( size_t i = 0; i < key.size() && i < line.size(); i++ ) {
+            result += key[i] ^ line[i];
+        }
+        sink << base64_encode( result.c_str(), result.size() ) << std::endl;
+        total += result.size();
+        result = "";
+    }
+    std::cout << std::left << std::setw( 22 ) << "encrypt original" << std::right << std::setw( 9 ) << total / seconds( start ) / 1e9 << std::endl;
+
+    FILE * null = std::fopen( "/dev/null", "wb" );
+    const char * names[] = { "stream scalar", "stream avx2" };
+    for ( bool avx : { false, true } ) {
+        if ( !xorStreamUseAvx2( avx ) ) {
+            continue;
+        }
+        XorStreamStats stats;
+        xorStream( "bench_key.bin", "bench_messages.txt", null, stats );
+        std::cout << std::left << std::setw( 22 ) << names[avx] << std::right << std::setw( 9 ) << stats.bytes / stats.seconds / 1e9 << std::endl;
+    }
+    std::fclose( null );
+    std::remove( "bench_messages.txt" );
+    std::remove( "bench_key.bin" );
+}
+
+/*
+ * Key length estimate of synthetic corpus with both Hamming kernels
+ */
+void benchAnalysis( size_t messages ) {
+    const std::string filename = "bench_corpus.tmp";
+    writeSyntheticCorpus( filename, messages, 331, 13 );
+    Corpus corpus;
+    corpus.load( filename );
+    std::remove( filename.c_str() );
+
+    std::cout << "key length estimate, " << messages << " messages of 331 bytes, periods up to 165" << std::endl;
+    std::cout << "kernel                    ms   keystream" << std::endl;
+    const char * names[] = { "hamming scalar", "hamming avx2" };
+    for ( bool avx : { false, true } ) {
+        if ( !analysisUseAvx2( avx ) ) {
+            continue;
+        }
+        Clock::time_point start = Clock::now();
+        KeyLengthEstimate estimate = estimateKeyLength( corpus );
+        std::cout << std::left << std::setw( 22 ) << names[avx] << std::right << std::setw( 8 ) << seconds( start ) * 1e3
+                  << std::setw( 12 ) << estimate.length() << std::endl;
+    }
+}
+
+/*
+ * Fragments of proj1/result.txt scanned by word automaton, half of them
+ * XORed with a random byte so both valid and broken text is scanned
+ */
+void benchWords( size_t fragments ) {
+    WordAutomaton words;
+    if ( !words.load( "../result.txt" ) ) {
+        std::cout << "word automaton skipped, ../result.txt missing" << std::endl;
+        return;
+    }
+    std::ifstream source( "../result.txt" );
+    std::string text, line;
+    while ( std::getline( source, line ) ) {
+        text += line + ' ';
+    }
+
+    std::mt19937 random( 5 );
+    std::vector<std::string> samples( 4096 );
+    for ( std::string & sample : samples ) {
+        size_t length = 16 + random() % 49;
+        sample = text.substr( random() % ( text.size() - length ), length );
+        if ( random() & 1 ) {
+            sample[random() % length] ^= 1 + random() % 31;
+        }
+    }
+
+    Clock::time_point start = Clock::now();
+    size_t bytes = 0, invalid = 0;
+    for ( size_t i = 0; i < fragments; i++ ) {
+        const std::string & sample = samples[i % samples.size()];
+        invalid += words.scan( sample.c_str(), sample.size() ).invalid != 0;
+        bytes   += sample.size();
+    }
+    double elapsed = seconds( start );
+    std::cout << "word automaton, " << words.states() << " states, " << fragments << " fragments of 16 to 64 bytes" << std::endl;
+    std::cout << "fragments/s        MB/s   rejected" << std::endl;
+    std::cout << std::setw( 11 ) << std::setprecision( 0 ) << fragments / elapsed << std::setw( 12 ) << std::setprecision( 1 )
+              << bytes / elapsed / 1e6 << std::setw( 10 ) << std::setprecision( 3 ) << static_cast<double>( invalid ) / fragments << std::endl;
+}
+
+int main( int argc, const char ** argv ) {
+    size_t megabytes = argc > 1 ? std::atoi( argv[1] ) : 64;
+    if ( !verifyBase64() ) {
+        return 1;
+    }
+    benchBase64( megabytes );
+    benchStreaming( megabytes );
+    benchCribDrag( 4096 );
+    benchXorStream( megabytes );
+    benchAnalysis( 4096 );
+    benchWords( 1 << 22 );
+    return 0;
+}
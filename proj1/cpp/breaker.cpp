@@ -1,45 +1,22 @@
 #include <iostream>
 #include "base64.h"
+#include "corpus.h"
+#include "cribdrag.h"
+#include "search.h"
+#include "keystream.h"
+#include "beam.h"
+#include "session.h"
+#include "xorstream.h"
+#include "analysis.h"
+#include "wordlist.h"
+#include "follow.h"
+#include <unistd.h>
+#include <iomanip>
+#include <thread>
 #include <string>
 #include <vector>
 #include <fstream>
-#define KEYSIZE 331
-
-std::vector<std::string> getFileContent( std::string const filename ) {
-    std::fstream file( filename );
-    std::vector<std::string> v;
-    if ( file.is_open() ) {
-        std::string line;
-        while ( std::getline( file, line ) ) {
-            v.push_back( line );
-        }
-    }
-    return v;
-}
-
-void decodeLines( std::vector<std::string> & lines ) {
-    for( std::string & line : lines ) {
-        line = base64_decode( line ).substr(0, KEYSIZE);
-    }
-}
-
-void encrypt( std::string const & keyFile, std::vector<std::string> messages ) {
-    std::ifstream file( keyFile, std::ios::binary | std::ios::ate);
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    std::vector<char> key( size );
-    std::string result = "";
-    if ( file.read( key.data(), size) ) {
-        for( std::string const & message : messages ) {
-            for( size_t i = 0; i < key.size() && i < message.size(); i++ ) {
-                result += key[i] ^ message[i];
-            }
-            std::cout << base64_encode( result.c_str(), result.size() ) << std::endl;
-            result = "";
-        }
-    }
-}
+#include <algorithm>
 
 std::string xorStrings( const std::string & s1, const std::string & s2, size_t pre = 0 ) {
     std::string result = "";
@@ -52,14 +29,6 @@ std::string xorStrings( const std::string & s1, const std::string & s2, size_t p
     return result;
 }
 
-std::vector<std::string> xorMessages( const std::vector<std::string> & messages, const std::string & message ) {
-    std::vector<std::string> v;
-    for( const std::string & m : messages ) {
-        v.push_back( xorStrings( m, message ) );
-    }
-    return v;
-}
-
 bool testReadable( const std::string s) {
     for( const char & a : s ) {
         if ( ( a < 'A' || a > 'Z' ) && ( a < 'a' || a > 'z' ) && a != '.' && a != ',' && a != ' ' ) {
@@ -106,113 +75,333 @@ void test() {
     }
 }
 
-std::string unlimitedPower( std::string const & word, std::vector<std::string> const & xoredMessages, size_t limit = 300, size_t pre = 0 ) {
-    static const std::string alfabet = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    if ( limit <= word.size() || pre == 0 ) {
-        return word;
-    }
-    std::string test = word + '#';
-    for( size_t i = 0; i < alfabet.size(); i++ ) {
-        test[ test.size() - 1 ] = alfabet[i];
-        std::cerr << "testing: \'" << test << "'.......";
-        bool ok = true;
-        for( std::string const & line : xoredMessages ) {
-            std::string result = xorStrings( test, line, pre );
-            if ( !testReadable( result ) ) {
-                ok = false;
-                break;
+std::string getKey( std::string cypher, std::string plain ) {
+    return xorStrings( cypher, plain );
+}
+
+/*
+ * Command line, options go before positional arguments
+ */
+struct Options {
+    std::string              dictionary;
+    std::string              model;
+    std::string              key;
+    std::string              words;
+    size_t                   threads;
+    size_t                   top;
+    size_t                   beam;
+    size_t                   keysize; // 0 estimates it from the corpus
+    size_t                   every;
+    bool                     automatic;
+    bool                     cache;
+    bool                     session;
+    bool                     analyze;
+    bool                     follow;
+    std::vector<std::string> positional;
+};
+
+bool parseOptions( int argc, char const *argv[], Options & options ) {
+    options.threads   = std::max( 1u, std::thread::hardware_concurrency() );
+    options.top       = 20;
+    options.beam      = 16;
+    options.automatic = false;
+    options.cache     = true;
+    options.session   = false;
+    options.analyze   = false;
+    options.follow    = false;
+    options.every     = 100;
+    options.keysize   = 0;
+    int i = 1;
+    for( ; i < argc && std::string( argv[i] ).compare( 0, 2, "--" ) == 0; i++ ) {
+        std::string option = argv[i];
+        if ( option == "--auto" ) {
+            options.automatic = true;
+        }
+        else if ( option == "--no-cache" ) {
+            options.cache = false;
+        }
+        else if ( option == "--session" ) {
+            options.session = true;
+        }
+        else if ( option == "--analyze" ) {
+            options.analyze = true;
+        }
+        else if ( option == "--follow" ) {
+            options.follow = true;
+        }
+        else if ( i + 1 >= argc ) {
+            return false;
+        }
+        else if ( option == "--dict" ) {
+            options.dictionary = argv[++i];
+        }
+        else if ( option == "--threads" ) {
+            options.threads = std::max( 1, std::atoi( argv[++i] ) );
+        }
+        else if ( option == "--encrypt" ) {
+            options.key = argv[++i];
+        }
+        else if ( option == "--words" ) {
+            options.words = argv[++i];
+        }
+        else if ( option == "--model" ) {
+            options.model = argv[++i];
+        }
+        else if ( option == "--top" ) {
+            options.top = std::max( 1, std::atoi( argv[++i] ) );
+        }
+        else if ( option == "--keysize" ) {
+            std::string value = argv[++i];
+            options.keysize = value == "auto" ? 0 : std::atoi( value.c_str() );
+            if ( value != "auto" && options.keysize == 0 ) {
+                return false;
             }
         }
-        if ( ok ) {
-            std::cerr << "Passed" << std::endl;
-            return unlimitedPower( test, xoredMessages, limit, pre );
+        else if ( option == "--every" ) {
+            options.every = std::max( 1, std::atoi( argv[++i] ) );
+        }
+        else if ( option == "--beam" ) {
+            options.beam = std::max( 1, std::atoi( argv[++i] ) );
+        }
+        else {
+            return false;
         }
-        std::cerr << "Failed" << std::endl;
     }
-    
-    test = '#' + word;
-    for( size_t i = 0; i < alfabet.size(); i++ ) {
-        test[0] = alfabet[i];
-        std::cerr << "testing: \'" << test << "'.......";
-        bool ok = true;
-        for( std::string const & line : xoredMessages ) {
-            std::string result = xorStrings( test, line, pre - 1 );
-            if ( !testReadable( result ) ) {
-                ok = false;
-                break;
-            }
+    for( ; i < argc; i++ ) {
+        options.positional.push_back( argv[i] );
+    }
+    return options.positional.size() >= ( options.dictionary.empty() && options.key.empty() && !options.automatic && !options.session && !options.analyze && !options.follow ? 2 : 1 );
+}
+
+/*
+ * Crib XORed with every message at offset breaks no message into something
+ * that is not a dictionary word
+ */
+bool wordsFit( const ColumnMatrix & matrix, const WordAutomaton & words, const std::string & word, size_t offset ) {
+    for( size_t k = 0; k < matrix.messages(); k++ ) {
+        std::string result = cribResult( matrix, word, offset, k );
+        if ( words.scan( result.c_str(), result.size() ).invalid ) {
+            return false;
         }
-        if ( ok ) {
-            std::cerr << "Passed" << std::endl;
-            return unlimitedPower( test, xoredMessages, limit, pre - 1 );
+    }
+    return true;
+}
+
+/*
+ * Ranks every offset of crib by language model instead of readability filter,
+ * prints top offsets with crib XORed with every message
+ */
+void scoredCribDrag( const ColumnMatrix & matrix, const std::string & word, const LanguageModel & model, size_t top,
+                     const WordAutomaton * words ) {
+    TopK<std::pair<double, size_t> > best( top );
+    for( size_t j = 0; j < matrix.minLength(); j++ ) {
+        if ( words && !wordsFit( matrix, *words, word, j ) ) {
+            continue;
+        }
+        best.push( std::make_pair( model.scoreColumns( matrix, word, j ), -j ) );
+    }
+    std::cout << std::fixed << std::setprecision( 3 );
+    for( const std::pair<double, size_t> & item : best.sorted() ) {
+        size_t j = -item.second;
+        std::cout << "offset " << j << " score " << item.first << '\n';
+        for( size_t k = 0; k < matrix.messages(); k++ ) {
+            std::cout << cribResult( matrix, word, j, k ) << '\n';
         }
-        std::cerr << "Failed" << std::endl;
     }
-    
-    return word;
 }
 
-std::string getKey( std::string cypher, std::string plain ) {
-    return xorStrings( cypher, plain );
+/*
+ * Runs every crib of dictionary at every offset, prints "score offset crib" best first
+ */
+int dictionarySearch( const ColumnMatrix & matrix, const Options & options, const LanguageModel * model ) {
+    std::vector<std::string> cribs;
+    std::ifstream file( options.dictionary );
+    std::string line;
+    while ( std::getline( file, line ) ) {
+        if ( !line.empty() ) {
+            cribs.push_back( line );
+        }
+    }
+    if ( cribs.empty() ) {
+        std::cerr << "No cribs in '" << options.dictionary << "'" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision( 3 );
+    for( const CribMatch & match : searchCribs( matrix, cribs, options.threads, model, options.top ) ) {
+        std::cout << match.score << ' ' << match.offset << ' ' << cribs[match.crib] << '\n';
+    }
+    return 0;
+}
+
+/*
+ * Prints key length estimate followed by "column messages coincidence"
+ * lines and "period distance" lines
+ */
+void printEstimate( const KeyLengthEstimate & estimate ) {
+    std::cout << "keystream " << estimate.keystream << '\n';
+    std::cout << "period " << estimate.period << '\n';
+    std::cout << std::fixed << std::setprecision( 3 );
+    for( size_t p = 0; p < estimate.coincidence.size(); p++ ) {
+        std::cout << "column " << p << ' ' << estimate.depth[p] << ' ' << estimate.coincidence[p] << '\n';
+    }
+    for( size_t period = 1; period < estimate.distance.size(); period++ ) {
+        std::cout << "distance " << period << ' ' << estimate.distance[period] << '\n';
+    }
+}
+
+/*
+ * Recovers keystream without cribs, prints it in hex followed by
+ * "position byte confidence messages" for every key position
+ */
+int automaticKey( const Corpus & corpus, const LanguageModel & model, const Options & options ) {
+    Keystream key = recoverKeystream( corpus, model, options.threads );
+    std::cout << std::hex << std::setfill( '0' );
+    for( unsigned char byte : key.bytes ) {
+        std::cout << std::setw( 2 ) << static_cast<int>( byte );
+    }
+    std::cout << '\n';
+    for( size_t p = 0; p < key.bytes.size(); p++ ) {
+        std::cout << std::dec << p << ' ' << std::hex << std::setw( 2 ) << static_cast<int>( key.bytes[p] ) << ' '
+                  << std::dec << std::fixed << std::setprecision( 3 ) << key.confidence[p] << ' ' << key.depth[p] << '\n';
+    }
+    return 0;
 }
 
 int main(int argc, char const *argv[]) {
-    if ( argc < 3 ) {
+    Options options;
+    if ( !parseOptions( argc, argv, options ) ) {
         std::cerr << "Invalid arguments. Run as ./breaker b64messages word [ messageIndex ] [ prefix ]" << std::endl;
+        std::cerr << "                  or ./breaker --dict cribs [ --threads n ] b64messages [ messageIndex ]" << std::endl;
+        std::cerr << "                  or ./breaker --auto [ --threads n ] b64messages" << std::endl;
+        std::cerr << "                  or ./breaker --session b64messages, commands are read from stdin" << std::endl;
+        std::cerr << "                  or ./breaker --encrypt key messages, prints base64 line per message" << std::endl;
+        std::cerr << "                  or ./breaker --analyze b64messages, prints key length statistics" << std::endl;
+        std::cerr << "                  or ./breaker --follow [ --every n ] b64messages|-, prints key as messages arrive" << std::endl;
+        std::cerr << "options --model text and --top k rank candidates by language model trained on text," << std::endl;
+        std::cerr << "        --beam k sets number of cribs kept while extending from prefix," << std::endl;
+        std::cerr << "        --no-cache does not read or write XORed pairs next to b64messages," << std::endl;
+        std::cerr << "        --words list keeps only candidates made of words from list," << std::endl;
+        std::cerr << "        --keysize n|auto truncates messages to n bytes or to estimated key length (default)" << std::endl;
         return 1;
     }
-    //encrypt( "./key.bin", "../result.txt" );
-/*    std::vector<std::string> messages = getFileContent( "../messages.txt" );
-    decodeLines( messages );
-    std::ofstream wf("../messages.shorted.txt", std::ios::out | std::ios::binary);
-    for( std::string & line : messages ) {
-        wf << base64_encode( line.c_str(), line.size() ) << '\n';
-    }
-    wf.close();
-    */
-    const char * filename = argv[1];
-    std::string word( argv[2] );
-    int index = argc >= 4 ? std::atoi( argv[3] ) : 0;
+    std::vector<std::string> & args = options.positional;
+    if ( !options.key.empty() ) {
+        XorStreamStats stats;
+        if ( !xorStream( options.key, args[0], stdout, stats ) ) {
+            std::cerr << "Unable to encrypt '" << args[0] << "' with key '" << options.key << "'" << std::endl;
+            return 1;
+        }
+        std::cerr << stats.messages << " messages, " << stats.bytes << " bytes, "
+                  << stats.bytes / std::max( stats.seconds, 1e-9 ) / 1e9 << " GB/s" << std::endl;
+        return 0;
+    }
+    const bool wordless = !options.dictionary.empty() || options.automatic || options.session || options.analyze || options.follow;
+    const std::string filename = args[0];
+    const std::string word = wordless ? "" : args[1];
+    const size_t argIndex = wordless ? 1 : 2;
+    size_t index = args.size() > argIndex ? std::atoi( args[argIndex].c_str() ) : 0;
     
-    std::vector<std::string> lines = getFileContent( filename );
-    decodeLines( lines );
+    LanguageModel model;
+    if ( !options.model.empty() && !model.train( options.model ) ) {
+        std::cerr << "Unable to read model text '" << options.model << "'" << std::endl;
+        return 1;
+    }
+    WordAutomaton automaton;
+    if ( !options.words.empty() && !automaton.load( options.words ) ) {
+        std::cerr << "Unable to read wordlist '" << options.words << "'" << std::endl;
+        return 1;
+    }
+    const WordAutomaton * words = automaton.empty() ? nullptr : &automaton;
+
+    if ( options.follow ) {
+        if ( !followCorpus( filename, model, options.keysize, options.every, std::cout ) ) {
+            std::cerr << "Unable to read '" << filename << "'" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    Corpus corpus;
+    if ( !corpus.load( filename ) || index >= corpus.size() ) {
+        std::cerr << "Unable to load message " << index << " from '" << filename << "'" << std::endl;
+        return 1;
+    }
+
+    // Messages are cut only after the estimate has seen all of their bytes
+    size_t keysize = options.keysize;
+    if ( keysize == 0 || options.analyze ) {
+        KeyLengthEstimate estimate = estimateKeyLength( corpus );
+        if ( options.analyze ) {
+            printEstimate( estimate );
+            return 0;
+        }
+        keysize = estimate.length();
+        std::cerr << "key length " << keysize << std::endl;
+
+        // Too few messages give no estimate at all and a keystream ending inside
+        // every message is a weak statistic rather than a key, so nothing is cut then
+        size_t shortest = corpus.size() ? corpus.length( 0 ) : 0;
+        for ( size_t i = 1; i < corpus.size(); i++ ) {
+            shortest = std::min( shortest, corpus.length( i ) );
+        }
+        if ( !estimate.period && keysize < shortest ) {
+            std::cerr << "Warning: key length estimate below shortest message (" << shortest
+                      << " bytes), messages are left whole, pass --keysize to cut them" << std::endl;
+            keysize = 0;
+        }
+    }
+    if ( keysize > 0 ) {
+        corpus.truncate( keysize );
+    }
+
+    if ( options.automatic ) {
+        return automaticKey( corpus, model, options );
+    }
+    if ( options.session ) {
+        Session session( corpus, model, options.threads );
+        session.run( std::cin, std::cout, isatty( STDIN_FILENO ) );
+        return 0;
+    }
+
+    // Pairs XORed by earlier runs are read from file next to the corpus
+    XorCache xorCache;
+    XorCache * cache = options.cache && xorCache.open( corpus, filename, xorCacheName( filename ) ) ? &xorCache : nullptr;
     
-    std::string current = lines[index];
 //    std::string plain   = "mluvit poamerictenejsi zaprisahnuti Plesak oindexovani environmentalista vizovicky podavanejsi shodovani tachyon Mysikova signalizovat opletacky Tikalova zolikovy Drahozalova starcu heovetstejsi zahmyzenejsi pristavaci lemniskata respektovani Nemeckuv Holeckuv nivelizacni wehrmacht dojmologie pojistovateluv federalizacni pazbicka";
 //    std::cout << getKey( current, plain );
     //lines.erase( lines.begin() + index );
-    std::vector<std::string> xored = xorMessages( lines, current );
-
-    if ( argc > 4 ) {
-        std::cout << unlimitedPower( word, xored, KEYSIZE, std::atoi( argv[4] ) ) << std::endl;
+    ColumnMatrix matrix;
+    matrix.build( corpus, index, cache );
+    if ( cache && !cache->flush() ) {
+        std::cerr << "Unable to write '" << xorCacheName( filename ) << "'" << std::endl;
+    }
+    if ( !options.dictionary.empty() ) {
+        return dictionarySearch( matrix, options, model.trained() ? &model : nullptr );
+    }
+    if ( args.size() > 3 ) {
+        size_t offset = std::atoi( args[3].c_str() );
+        std::string extended = beamExtend( matrix, model, word, offset, keysize ? keysize : matrix.positions(), options.beam, words );
+        std::cerr << "offset " << offset << std::endl;
+        std::cout << extended << std::endl;
         return 0;
     }
-    
-    size_t min = -1;
-    for( std::string & line : xored ){
-        min = line.size() < min ? line.size() : min;
+    if ( model.trained() ) {
+        scoredCribDrag( matrix, word, model, options.top, words );
+        return 0;
     }
 
     // pro kazdou z xorovanych zprav budu hledat slovo
-    size_t k = 0;
     std::string tmp = "";
-    for( size_t j = 0; j < min; j++ ) {
-        k = 0;
-        for( std::string & line : xored ) {
-            std::string result = xorStrings( word, line, j );
-            if ( testReadable( result ) ) {
-                tmp += result + '\n';
-            }
-            else {
-                tmp = "";
-                break;
-            }
-            k++;
+    for( size_t j : cribDrag( matrix, word ) ) {
+        if ( words && !wordsFit( matrix, *words, word, j ) ) {
+            continue;
         }
-        if ( tmp.size() ) {
-            std::cout << tmp;
-            tmp = "";
+        for( size_t k = 0; k < matrix.messages(); k++ ) {
+            tmp += cribResult( matrix, word, j, k ) + '\n';
         }
+        std::cout << tmp;
+        tmp = "";
     }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "corpus.h"
+#include "base64.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Corpus::Corpus() : arena_( nullptr ) {}
+
+Corpus::~Corpus() {
+    std::free( arena_ );
+}
+
+bool Corpus::load( const std::string & filename ) {
+    int fd = open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        return false;
+    }
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 ) {
+        close( fd );
+        return false;
+    }
+    size_t size = info.st_size;
+    const char * file = nullptr;
+    if ( size ) {
+        void * map = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( map == MAP_FAILED ) {
+            close( fd );
+            return false;
+        }
+        madvise( map, size, MADV_SEQUENTIAL );
+        file = static_cast<const char *>( map );
+    }
+    close( fd );
+
+    std::free( arena_ );
+    messages_.clear();
+    void * arena = nullptr;
+    if ( posix_memalign( &arena, ALIGNMENT, base64_decode_bound( size ) + ALIGNMENT ) != 0 ) {
+        arena_ = nullptr;
+        munmap( const_cast<char *>( file ), size );
+        return false;
+    }
+    arena_ = static_cast<char *>( arena );
+
+    // Every line is one message, the same as std::getline would split them
+    base64_decoder decoder;
+    size_t used = 0, written = 0;
+    for ( size_t pos = 0; pos < size; ) {
+        const char * newline = static_cast<const char *>( std::memchr( file + pos, '\n', size - pos ) );
+        size_t end = newline ? newline - file : size;
+        size_t stop = end > pos && file[end - 1] == '\r' ? end - 1 : end;
+
+        MessageView message = { used, 0 };
+        if ( decoder.update( file + pos, stop - pos, arena_ + used, written ) ) {
+            used += written;
+            decoder.finish( arena_ + used, written );
+        }
+        used += written;
+        decoder.reset();
+        message.length = used - message.offset;
+        messages_.push_back( message );
+        pos = end + 1;
+    }
+
+    if ( file ) {
+        munmap( const_cast<char *>( file ), size );
+    }
+    return true;
+}
+
+void Corpus::truncate( size_t length ) {
+    for ( MessageView & message : messages_ ) {
+        message.length = std::min( message.length, length );
+    }
+}
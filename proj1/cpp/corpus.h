@@ -0,0 +1,48 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <string>
+#include <vector>
+
+/*
+ * View of one message inside of corpus arena
+ */
+struct MessageView {
+    size_t offset;
+    size_t length;
+};
+
+/*
+ * File of base64 lines decoded into one contiguous, cache aligned arena.
+ * The file is memory mapped and scanned once, messages are views to the arena.
+ */
+class Corpus {
+public:
+    static const size_t ALIGNMENT = 64;
+
+    Corpus();
+    ~Corpus();
+
+    bool load( const std::string & filename );
+
+    /*
+     * Shortens messages to at most length bytes, nothing is copied
+     */
+    void truncate( size_t length );
+
+    size_t size() const { return messages_.size(); }
+    const char * data( size_t i ) const { return arena_ + messages_[i].offset; }
+    size_t length( size_t i ) const { return messages_[i].length; }
+    std::string str( size_t i ) const { return std::string( data( i ), length( i ) ); }
+
+    const std::vector<MessageView> & messages() const { return messages_; }
+
+private:
+    Corpus( const Corpus & );
+    Corpus & operator=( const Corpus & );
+
+    char *                   arena_;
+    std::vector<MessageView> messages_;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "cribdrag.h"
+#include <algorithm>
+#include <immintrin.h>
+
+/*
+ * Characters accepted by testReadable(): letters, space, dot and comma
+ */
+struct ReadableTable {
+    bool value[256];
+
+    ReadableTable() {
+        for ( int c = 0; c < 256; c++ ) {
+            value[c] = ( c >= 'A' && c <= 'Z' ) || ( c >= 'a' && c <= 'z' ) || c == '.' || c == ',' || c == ' ';
+        }
+    }
+};
+
+static const ReadableTable readable;
+
+bool cribReadable( unsigned char c ) {
+    return readable.value[c];
+}
+
+ColumnMatrix::ColumnMatrix() : messages_( 0 ), positions_( 0 ), stride_( 0 ), minLength_( 0 ) {}
+
+void ColumnMatrix::build( const Corpus & corpus, size_t reference, XorCache * cache ) {
+    const char * ref = corpus.data( reference );
+    messages_  = corpus.size();
+    stride_    = ( messages_ + BLOCK - 1 ) / BLOCK * BLOCK;
+    positions_ = 0;
+    minLength_ = messages_ ? static_cast<size_t>( -1 ) : 0;
+    lengths_.resize( messages_ );
+    for ( size_t m = 0; m < messages_; m++ ) {
+        lengths_[m] = std::min( corpus.length( m ), corpus.length( reference ) );
+        positions_  = std::max( positions_, lengths_[m] );
+        minLength_  = std::min( minLength_, lengths_[m] );
+    }
+
+    data_.assign( positions_ * stride_, 0 );
+    padding_.assign( positions_ * stride_, 0xff );
+
+    std::vector<const unsigned char *> pairs( cache ? messages_ : 0 );
+    for ( size_t m = 0; m < pairs.size(); m++ ) {
+        pairs[m] = cache->pair( m, reference );
+    }
+
+    // Transposed in blocks of messages, so written rows stay in cache
+    for ( size_t first = 0; first < messages_; first += BLOCK ) {
+        size_t last = std::min( first + BLOCK, messages_ );
+        for ( size_t p = 0; p < positions_; p++ ) {
+            unsigned char * row = data_.data() + p * stride_;
+            unsigned char * pad = padding_.data() + p * stride_;
+            for ( size_t m = first; m < last; m++ ) {
+                if ( p < lengths_[m] ) {
+                    row[m] = cache ? pairs[m][p] : corpus.data( m )[p] ^ ref[p];
+                    pad[m] = 0;
+                }
+            }
+        }
+    }
+}
+
+bool cribFitsScalar( const ColumnMatrix & matrix, const std::string & crib, size_t offset ) {
+    size_t end = std::min( offset + crib.size(), matrix.positions() );
+    for ( size_t m = 0; m < matrix.messages(); m++ ) {
+        for ( size_t p = offset; p < end; p++ ) {
+            unsigned char c = matrix.column( p )[m] ^ crib[p - offset];
+            if ( !readable.value[c] && !matrix.padding( p )[m] ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Classification by two nibble lookups, low nibble selects which high
+ * nibbles are readable: bit 0 = 0x2_, 1 = 0x4_, 2 = 0x5_, 3 = 0x6_, 4 = 0x7_
+ */
+__attribute__((target("avx2")))
+bool cribFitsAvx2( const ColumnMatrix & matrix, const std::string & crib, size_t offset ) {
+    const __m256i lutLow = _mm256_setr_epi8( 0x15, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e,
+                                             0x1e, 0x1e, 0x1e, 0x0a, 0x0b, 0x0a, 0x0b, 0x0a,
+                                             0x15, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e,
+                                             0x1e, 0x1e, 0x1e, 0x0a, 0x0b, 0x0a, 0x0b, 0x0a );
+    const __m256i lutHigh = _mm256_setr_epi8( 0, 0, 0x01, 0, 0x02, 0x04, 0x08, 0x10, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 0, 0x01, 0, 0x02, 0x04, 0x08, 0x10, 0, 0, 0, 0, 0, 0, 0, 0 );
+    const __m256i nibble = _mm256_set1_epi8( 0x0f );
+    const __m256i zero   = _mm256_setzero_si256();
+
+    size_t end = std::min( offset + crib.size(), matrix.positions() );
+    for ( size_t block = 0; block < matrix.stride(); block += ColumnMatrix::BLOCK ) {
+        for ( size_t p = offset; p < end; p++ ) {
+            __m256i v   = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( matrix.column( p ) + block ) );
+            __m256i pad = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( matrix.padding( p ) + block ) );
+            v = _mm256_xor_si256( v, _mm256_set1_epi8( crib[p - offset] ) );
+            __m256i low  = _mm256_shuffle_epi8( lutLow, _mm256_and_si256( v, nibble ) );
+            __m256i high = _mm256_shuffle_epi8( lutHigh, _mm256_and_si256( _mm256_srli_epi16( v, 4 ), nibble ) );
+            __m256i bad  = _mm256_cmpeq_epi8( _mm256_and_si256( low, high ), zero );
+            if ( _mm256_movemask_epi8( _mm256_andnot_si256( pad, bad ) ) ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool avx2Supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+}
+
+static bool ( *fitsKernel )( const ColumnMatrix &, const std::string &, size_t ) = avx2Supported() ? cribFitsAvx2 : cribFitsScalar;
+
+bool cribDragUseAvx2( bool enable ) {
+    if ( enable && !avx2Supported() ) {
+        return false;
+    }
+    fitsKernel = enable ? cribFitsAvx2 : cribFitsScalar;
+    return true;
+}
+
+bool cribFits( const ColumnMatrix & matrix, const std::string & crib, size_t offset ) {
+    return fitsKernel( matrix, crib, offset );
+}
+
+std::vector<size_t> cribDrag( const ColumnMatrix & matrix, const std::string & crib ) {
+    std::vector<size_t> offsets;
+    for ( size_t j = 0; j < matrix.minLength(); j++ ) {
+        if ( fitsKernel( matrix, crib, j ) ) {
+            offsets.push_back( j );
+        }
+    }
+    return offsets;
+}
+
+std::string cribResult( const ColumnMatrix & matrix, const std::string & crib, size_t offset, size_t message ) {
+    std::string result;
+    for ( size_t p = offset; p < offset + crib.size() && p < matrix.length( message ); p++ ) {
+        result += static_cast<char>( matrix.column( p )[message] ^ crib[p - offset] );
+    }
+    return result;
+}
@@ -0,0 +1,73 @@
+#ifndef CRIBDRAG_H
+#define CRIBDRAG_H
+
+#include <string>
+#include <vector>
+#include "corpus.h"
+#include "xorcache.h"
+
+/*
+ * Messages XORed with reference message, stored column major. Byte of
+ * message m at position p lives at column( p )[m], rows are padded to
+ * a multiple of 32 messages. Bytes past the end of a message are marked
+ * in padding( p ), the readability check passes there the same way
+ * xorStrings() stops at the end of the shorter string.
+ */
+class ColumnMatrix {
+public:
+    static const size_t BLOCK = 32;
+
+    ColumnMatrix();
+
+    /*
+     * Rows are taken from cache when given, so a new reference reuses pairs
+     * computed by earlier runs
+     */
+    void build( const Corpus & corpus, size_t reference, XorCache * cache = nullptr );
+
+    size_t messages()  const { return messages_; }
+    size_t positions() const { return positions_; }
+    size_t stride()    const { return stride_; }
+    size_t length( size_t message ) const { return lengths_[message]; }
+    size_t minLength() const { return minLength_; }
+
+    const unsigned char * column( size_t position )  const { return data_.data() + position * stride_; }
+    const unsigned char * padding( size_t position ) const { return padding_.data() + position * stride_; }
+
+private:
+    size_t                     messages_;
+    size_t                     positions_;
+    size_t                     stride_;
+    size_t                     minLength_;
+    std::vector<size_t>        lengths_;
+    std::vector<unsigned char> data_;
+    std::vector<unsigned char> padding_;
+};
+
+/*
+ * Returns offsets below minimal message length where crib XORed with every
+ * message is readable text
+ */
+std::vector<size_t> cribDrag( const ColumnMatrix & matrix, const std::string & crib );
+
+/*
+ * Tests one offset, the same check cribDrag() does for every offset
+ */
+bool cribFits( const ColumnMatrix & matrix, const std::string & crib, size_t offset );
+
+/*
+ * Crib XORed with message at offset, cut at the end of the message
+ */
+std::string cribResult( const ColumnMatrix & matrix, const std::string & crib, size_t offset, size_t message );
+
+/*
+ * Character accepted by testReadable()
+ */
+bool cribReadable( unsigned char c );
+
+/*
+ * Selects AVX2 kernel when available, returns false when forced but unsupported
+ */
+bool cribDragUseAvx2( bool enable );
+
+#endif
@@ -0,0 +1,128 @@
+#include "follow.h"
+#include "base64.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <iomanip>
+#include <thread>
+#include <unistd.h>
+
+static const size_t READ_SIZE = 1 << 16;
+static const int    POLL_MS   = 200;
+
+KeystreamTracker::KeystreamTracker( size_t limit ) : limit_( limit ), messages_( 0 ) {}
+
+void KeystreamTracker::add( const unsigned char * message, size_t length ) {
+    if ( limit_ ) {
+        length = std::min( length, limit_ );
+    }
+    if ( length > key_.bytes.size() ) {
+        histogram_.resize( length * 256, 0 );
+        dirty_.resize( length, 0 );
+        key_.bytes.resize( length, 0 );
+        key_.confidence.resize( length, 0 );
+        key_.depth.resize( length, 0 );
+    }
+    for ( size_t p = 0; p < length; p++ ) {
+        histogram_[p * 256 + message[p]]++;
+        key_.depth[p]++;
+        if ( !dirty_[p] ) {
+            dirty_[p] = 1;
+            changed_.push_back( p );
+        }
+    }
+    messages_++;
+}
+
+const Keystream & KeystreamTracker::solve( const LanguageModel & model ) {
+    for ( size_t p : changed_ ) {
+        solveColumn( histogram_.data() + p * 256, model, key_.bytes[p], key_.confidence[p] );
+        dirty_[p] = 0;
+    }
+    changed_.clear();
+    return key_;
+}
+
+static void emit( KeystreamTracker & tracker, const LanguageModel & model, std::ostream & out ) {
+    const Keystream & key = tracker.solve( model );
+    double confidence = 0;
+    out << tracker.messages() << ' ' << std::hex << std::setfill( '0' );
+    for ( size_t p = 0; p < key.bytes.size(); p++ ) {
+        out << std::setw( 2 ) << static_cast<int>( key.bytes[p] );
+        confidence += key.confidence[p];
+    }
+    out << std::dec << std::setfill( ' ' ) << ' ' << std::fixed << std::setprecision( 3 )
+        << ( key.bytes.empty() ? 0 : confidence / key.bytes.size() ) << std::endl;
+}
+
+/*
+ * Decodes one base64 line into tracker, malformed lines are skipped
+ */
+static void addLine( KeystreamTracker & tracker, base64_decoder & decoder, std::string & line, std::vector<char> & decoded ) {
+    if ( !line.empty() && line.back() == '\r' ) {
+        line.pop_back();
+    }
+    decoded.resize( base64_decode_bound( line.size() ) );
+    size_t written = 0, tail = 0;
+    if ( decoder.update( line.data(), line.size(), decoded.data(), written ) && decoder.finish( decoded.data() + written, tail ) ) {
+        tracker.add( reinterpret_cast<const unsigned char *>( decoded.data() ), written + tail );
+    }
+    decoder.reset();
+    line.clear();
+}
+
+bool followCorpus( const std::string & filename, const LanguageModel & model, size_t limit, size_t every, std::ostream & out ) {
+    const bool input = filename == "-";
+    int fd = input ? STDIN_FILENO : open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        return false;
+    }
+
+    KeystreamTracker tracker( limit );
+    std::vector<char> chunk( READ_SIZE ), decoded;
+    std::string line;
+    size_t emitted = 0;
+    base64_decoder decoder;
+    while ( true ) {
+        ssize_t got = read( fd, chunk.data(), chunk.size() );
+        if ( got < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( got <= 0 ) {
+            // Idle input gets the latest key, standard input ends here with its last line
+            // possibly missing the newline
+            if ( input && got == 0 && !line.empty() ) {
+                addLine( tracker, decoder, line, decoded );
+            }
+            if ( tracker.messages() != emitted ) {
+                emit( tracker, model, out );
+                emitted = tracker.messages();
+            }
+            if ( input || got < 0 ) {
+                break;
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( POLL_MS ) );
+            continue;
+        }
+
+        // Partial line stays in line until its newline arrives
+        for ( char * pos = chunk.data(), * end = pos + got; pos < end; ) {
+            char * newline = std::find( pos, end, '\n' );
+            line.append( pos, newline );
+            pos = newline + 1;
+            if ( newline == end ) {
+                break;
+            }
+            addLine( tracker, decoder, line, decoded );
+            if ( every && tracker.messages() - emitted >= every ) {
+                emit( tracker, model, out );
+                emitted = tracker.messages();
+            }
+        }
+    }
+    if ( !input ) {
+        close( fd );
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "keystream.h"
+#include "score.h"
+
+/*
+ * Column histograms of messages seen so far. Adding a message costs its
+ * length, solving re-runs solveColumn() only for columns that changed since
+ * the last solve, so neither depends on how many messages came before.
+ */
+class KeystreamTracker {
+public:
+    /*
+     * Messages are cut to limit bytes, 0 keeps them whole
+     */
+    explicit KeystreamTracker( size_t limit = 0 );
+
+    void add( const unsigned char * message, size_t length );
+
+    const Keystream & solve( const LanguageModel & model );
+
+    size_t messages() const { return messages_; }
+
+private:
+    size_t                     limit_;
+    size_t                     messages_;
+    std::vector<unsigned>      histogram_;
+    std::vector<unsigned char> dirty_;
+    std::vector<size_t>        changed_;
+    Keystream                  key_;
+};
+
+/*
+ * Reads base64 lines of filename as they arrive, "-" reads standard input
+ * until it ends, a file is followed like tail -f. Every every messages, and
+ * when input goes idle, prints "messages keystream meanConfidence".
+ */
+bool followCorpus( const std::string & filename, const LanguageModel & model, size_t limit, size_t every, std::ostream & out );
+
+#endif
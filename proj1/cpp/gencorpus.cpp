@@ -0,0 +1,60 @@
+/*
+ * Writes synthetic many-time-pad corpus of base64 lines to standard output,
+ * run as ./gencorpus [ options ] count [ length [ jitter ] ]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "synthetic.h"
+
+int main( int argc, const char ** argv ) {
+    std::string source = "../result.txt", keyFile, model = "words";
+    unsigned seed = 1;
+    std::vector<std::string> args;
+    for ( int i = 1; i < argc; i++ ) {
+        std::string option = argv[i];
+        if ( option.compare( 0, 2, "--" ) != 0 ) {
+            args.push_back( option );
+        }
+        else if ( i + 1 >= argc ) {
+            args.clear();
+            break;
+        }
+        else if ( option == "--source" ) {
+            source = argv[++i];
+        }
+        else if ( option == "--model" ) {
+            model = argv[++i];
+        }
+        else if ( option == "--seed" ) {
+            seed = std::atoi( argv[++i] );
+        }
+        else if ( option == "--key" ) {
+            keyFile = argv[++i];
+        }
+        else {
+            args.clear();
+            break;
+        }
+    }
+    if ( args.empty() || args.size() > 3 || ( model != "words" && model != "bigram" ) ) {
+        std::cerr << "Run as ./gencorpus [ --source text ] [ --model words|bigram ] [ --seed n ] [ --key key.bin ] count [ length [ jitter ] ]" << std::endl;
+        return 1;
+    }
+    size_t count  = std::strtoull( args[0].c_str(), nullptr, 10 );
+    size_t length = args.size() > 1 ? std::atoi( args[1].c_str() ) : 331;
+    size_t jitter = args.size() > 2 ? std::atoi( args[2].c_str() ) : 0;
+
+    SyntheticCorpus corpus;
+    if ( !corpus.train( source ) ) {
+        std::cerr << "Unable to read '" << source << "', using random letters" << std::endl;
+    }
+    corpus.configure( length, jitter, model == "words" ? SYNTHETIC_WORDS : SYNTHETIC_BIGRAM, seed );
+    if ( !keyFile.empty() ) {
+        std::ofstream( keyFile, std::ios::binary ) << corpus.key();
+    }
+    return corpus.write( stdout, count ) ? 0 : 1;
+}
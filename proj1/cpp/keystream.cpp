@@ -0,0 +1,88 @@
+#include "keystream.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+static const size_t CHUNK = 16;
+
+void solveColumn( const unsigned * histogram, const LanguageModel & model, unsigned char & key, double & confidence ) {
+    // Only bytes that occur in the column take part in the inner loop
+    unsigned char values[256];
+    float         counts[256];
+    size_t        used = 0;
+    for ( int c = 0; c < 256; c++ ) {
+        if ( histogram[c] ) {
+            values[used]   = c;
+            counts[used++] = histogram[c];
+        }
+    }
+
+    double scores[256];
+    double best = -HUGE_VAL;
+    key = 0;
+    for ( int k = 0; k < 256; k++ ) {
+        double sum = 0;
+        for ( size_t i = 0; i < used; i++ ) {
+            sum += counts[i] * model.frequency( values[i] ^ k );
+        }
+        scores[k] = sum;
+        if ( sum > best ) {
+            best = sum;
+            key  = k;
+        }
+    }
+
+    if ( used == 0 ) {
+        confidence = 0;
+        return;
+    }
+    double total = 0;
+    for ( int k = 0; k < 256; k++ ) {
+        total += std::exp( scores[k] - best );
+    }
+    confidence = 1 / total;
+}
+
+Keystream recoverKeystream( const Corpus & corpus, const LanguageModel & model, size_t threads ) {
+    size_t length = 0;
+    for ( size_t i = 0; i < corpus.size(); i++ ) {
+        length = std::max( length, corpus.length( i ) );
+    }
+
+    Keystream result;
+    result.bytes.resize( length );
+    result.confidence.resize( length );
+    result.depth.resize( length );
+
+    std::atomic<size_t> next( 0 );
+    auto worker = [&]() {
+        unsigned histogram[256];
+        for ( size_t begin; ( begin = next.fetch_add( CHUNK ) ) < length; ) {
+            size_t end = std::min( length, begin + CHUNK );
+            for ( size_t p = begin; p < end; p++ ) {
+                std::fill( histogram, histogram + 256, 0 );
+                size_t depth = 0;
+                for ( size_t m = 0; m < corpus.size(); m++ ) {
+                    if ( p < corpus.length( m ) ) {
+                        histogram[static_cast<unsigned char>( corpus.data( m )[p] )]++;
+                        depth++;
+                    }
+                }
+                result.depth[p] = depth;
+                solveColumn( histogram, model, result.bytes[p], result.confidence[p] );
+            }
+        }
+    };
+
+    threads = std::max<size_t>( 1, std::min( threads, length / CHUNK + 1 ) );
+    std::vector<std::thread> pool;
+    for ( size_t i = 1; i < threads; i++ ) {
+        pool.push_back( std::thread( worker ) );
+    }
+    worker();
+    for ( std::thread & thread : pool ) {
+        thread.join();
+    }
+    return result;
+}
@@ -0,0 +1,32 @@
+#ifndef KEYSTREAM_H
+#define KEYSTREAM_H
+
+#include <vector>
+#include "corpus.h"
+#include "score.h"
+
+/*
+ * Keystream recovered column by column. Confidence is the posterior
+ * probability of the chosen byte among all 256 candidates, 0 where no
+ * message reaches the position.
+ */
+struct Keystream {
+    std::vector<unsigned char> bytes;
+    std::vector<double>        confidence;
+    std::vector<size_t>        depth; // messages covering the position
+};
+
+/*
+ * Solves every key position independently. Ciphertext bytes of a column are
+ * counted into a histogram once, then each of 256 key bytes is scored as
+ * sum of count * frequency( c ^ key ), so the cost is linear in corpus size
+ * plus 256 * 256 per column. Columns are split between threads.
+ */
+Keystream recoverKeystream( const Corpus & corpus, const LanguageModel & model, size_t threads );
+
+/*
+ * Same solver for one column histogram, shared with streaming ingestion
+ */
+void solveColumn( const unsigned * histogram, const LanguageModel & model, unsigned char & key, double & confidence );
+
+#endif
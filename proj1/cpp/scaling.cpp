@@ -0,0 +1,139 @@
+/*
+ * Scaling benchmark of breaker stages on synthetic corpora of growing size,
+ * run as ./scaling [ --min n ] [ --max n ] [ --length n ] [ --threads n ] [ --csv file ]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "corpus.h"
+#include "cribdrag.h"
+#include "keystream.h"
+#include "score.h"
+#include "synthetic.h"
+#include "xorcache.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds( Clock::time_point start ) {
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+/*
+ * One CSV row and one aligned line on standard output, result is the number
+ * of crib matches for cribdrag, fraction of pairs read from cache for xor and
+ * fraction of correct key bytes for keyrecovery. Stages without a byte count
+ * leave MB/s empty
+ */
+static void record( std::ofstream & csv, size_t messages, size_t length, const std::string & stage, double elapsed, double bytes,
+                    double result ) {
+    std::string rate = "-";
+    if ( bytes > 0 ) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision( 1 ) << bytes / elapsed / 1e6;
+        rate = out.str();
+    }
+    csv << messages << ',' << length << ',' << stage << ',' << elapsed << ',' << ( bytes > 0 ? rate : "" ) << ',' << result << '\n';
+    std::cout << std::left << std::setw( 12 ) << messages << std::setw( 14 ) << stage << std::right << std::defaultfloat
+              << std::setprecision( 4 ) << std::setw( 12 ) << elapsed << std::setw( 12 ) << rate
+              << std::fixed << std::setprecision( 3 ) << std::setw( 10 ) << result << std::endl;
+}
+
+int main( int argc, const char ** argv ) {
+    size_t minimum = 1000, maximum = 100000, length = 331;
+    size_t threads = std::max( 1u, std::thread::hardware_concurrency() );
+    std::string csvFile = "scaling.csv";
+    for ( int i = 1; i + 1 < argc; i += 2 ) {
+        std::string option = argv[i];
+        if ( option == "--min" ) {
+            minimum = std::strtoull( argv[i + 1], nullptr, 10 );
+        }
+        else if ( option == "--max" ) {
+            maximum = std::strtoull( argv[i + 1], nullptr, 10 );
+        }
+        else if ( option == "--length" ) {
+            length = std::atoi( argv[i + 1] );
+        }
+        else if ( option == "--threads" ) {
+            threads = std::max( 1, std::atoi( argv[i + 1] ) );
+        }
+        else if ( option == "--csv" ) {
+            csvFile = argv[i + 1];
+        }
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream csv( csvFile );
+    csv << "messages,length,stage,seconds,mb_per_s,result\n";
+    std::cout << "messages    stage              seconds        MB/s    result" << std::endl;
+
+    const std::string filename = "scaling_corpus.tmp";
+    LanguageModel model;
+    for ( size_t messages = std::max<size_t>( minimum, 1 ); messages <= maximum; messages *= 10 ) {
+        SyntheticCorpus synthetic;
+        synthetic.train( "../result.txt" );
+        synthetic.configure( length, 0, SYNTHETIC_WORDS, 17 );
+        double bytes = static_cast<double>( messages ) * length;
+
+        Clock::time_point start = Clock::now();
+        FILE * file = std::fopen( filename.c_str(), "wb" );
+        bool written = file && synthetic.write( file, messages );
+        written = file && std::fclose( file ) == 0 && written;
+        if ( !written ) {
+            std::cerr << "Unable to write '" << filename << "'" << std::endl;
+            return 1;
+        }
+        record( csv, messages, length, "generate", seconds( start ), bytes, 1 );
+
+        Corpus corpus;
+        start = Clock::now();
+        if ( !corpus.load( filename ) ) {
+            std::cerr << "Unable to load '" << filename << "'" << std::endl;
+            std::remove( filename.c_str() );
+            return 1;
+        }
+        record( csv, messages, length, "decode", seconds( start ), bytes, 1 );
+
+        // Cold run computes pairs and writes the cache, warm run reads them back
+        ColumnMatrix matrix;
+        for ( const char * stage : { "xor", "xor_warm" } ) {
+            XorCache cache;
+            start = Clock::now();
+            bool opened = cache.open( corpus, filename, xorCacheName( filename ) );
+            matrix.build( corpus, 0, opened ? &cache : nullptr );
+            cache.flush();
+            record( csv, messages, length, stage, seconds( start ), bytes, static_cast<double>( cache.cached() ) / messages );
+        }
+        std::remove( xorCacheName( filename ).c_str() );
+        std::remove( filename.c_str() );
+
+        // Drag stops at first unreadable message, so bytes per second means nothing,
+        // seconds are per tested crib offset instead
+        const char * cribs[] = { "ni ", " a ", "ovat" };
+        start = Clock::now();
+        size_t found = 0;
+        for ( const char * crib : cribs ) {
+            found += cribDrag( matrix, crib ).size();
+        }
+        size_t offsets = std::max<size_t>( 3 * matrix.minLength(), 1 );
+        record( csv, messages, length, "cribdrag", seconds( start ) / offsets, 0, found );
+
+        start = Clock::now();
+        Keystream key = recoverKeystream( corpus, model, threads );
+        double elapsed = seconds( start );
+        size_t correct = 0;
+        for ( size_t p = 0; p < key.bytes.size(); p++ ) {
+            correct += key.bytes[p] == static_cast<unsigned char>( synthetic.key()[p] );
+        }
+        record( csv, messages, length, "keyrecovery", elapsed, bytes, static_cast<double>( correct ) / length );
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "score.h"
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+static const double SMOOTHING = 0.5;
+static const double LAMBDA3   = 0.6;
+static const double LAMBDA2   = 0.3;
+static const double LAMBDA1   = 0.1;
+
+LanguageModel::LanguageModel() : trained_( false ), trigram_( CLASSES * CLASSES * CLASSES ) {
+    for ( int c = 0; c < 256; c++ ) {
+        int lower = c | 0x20;
+        if ( lower >= 'a' && lower <= 'z' ) {
+            classes_[c] = lower - 'a';
+        }
+        else if ( c == ' ' ) {
+            classes_[c] = 26;
+        }
+        else if ( c == '.' ) {
+            classes_[c] = 27;
+        }
+        else if ( c == ',' ) {
+            classes_[c] = 28;
+        }
+        else if ( c >= '0' && c <= '9' ) {
+            classes_[c] = 29;
+        }
+        else if ( c > ' ' && c < 0x7f ) {
+            classes_[c] = 30;
+        }
+        else {
+            classes_[c] = START;
+        }
+    }
+    // Untrained model only knows characters accepted by testReadable()
+    std::vector<double> bytes( 256, 0 );
+    for ( const char * c = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ ., "; *c; c++ ) {
+        bytes[static_cast<unsigned char>( *c )] += 1;
+    }
+    build( bytes, std::vector<double>( CLASSES * CLASSES, 0 ), std::vector<double>( CLASSES * CLASSES * CLASSES, 0 ) );
+}
+
+bool LanguageModel::train( const std::string & filename ) {
+    std::ifstream file( filename, std::ios::binary );
+    if ( !file.is_open() ) {
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    trainText( text.str() );
+    return true;
+}
+
+void LanguageModel::trainText( const std::string & text ) {
+    std::vector<double> bytes( 256, 0 ), bigrams( CLASSES * CLASSES, 0 ), trigrams( CLASSES * CLASSES * CLASSES, 0 );
+    int a = START, b = START;
+    for ( unsigned char c : text ) {
+        if ( c == '\n' || c == '\r' ) {
+            a = b = START;
+            continue;
+        }
+        int k = classes_[c];
+        bytes[c]++;
+        bigrams[b * CLASSES + k]++;
+        trigrams[( a * CLASSES + b ) * CLASSES + k]++;
+        a = b;
+        b = k;
+    }
+    build( bytes, bigrams, trigrams );
+    trained_ = true;
+}
+
+void LanguageModel::build( const std::vector<double> & bytes, const std::vector<double> & bigrams, const std::vector<double> & trigrams ) {
+    std::vector<double> unigram( CLASSES, 0 );
+    double total = 0;
+    for ( int c = 0; c < 256; c++ ) {
+        unigram[classes_[c]] += bytes[c];
+        total += bytes[c];
+    }
+
+    // log P( byte | class ), unseen bytes of a class get half a count
+    std::vector<double> classSize( CLASSES, 0 );
+    for ( int c = 0; c < 256; c++ ) {
+        classSize[classes_[c]]++;
+    }
+    for ( int c = 0; c < 256; c++ ) {
+        int k = classes_[c];
+        byte_[c] = std::log( ( bytes[c] + SMOOTHING ) / ( unigram[k] + SMOOTHING * classSize[k] ) );
+    }
+
+    std::vector<double> p1( CLASSES );
+    for ( int k = 0; k < CLASSES; k++ ) {
+        p1[k] = ( unigram[k] + SMOOTHING ) / ( total + SMOOTHING * CLASSES );
+    }
+    for ( int c = 0; c < 256; c++ ) {
+        frequency_[c] = std::log( p1[classes_[c]] ) + byte_[c];
+    }
+    for ( int a = 0; a < CLASSES; a++ ) {
+        for ( int b = 0; b < CLASSES; b++ ) {
+            double context2 = 0, context3 = 0;
+            for ( int k = 0; k < CLASSES; k++ ) {
+                context2 += bigrams[b * CLASSES + k];
+                context3 += trigrams[( a * CLASSES + b ) * CLASSES + k];
+            }
+            for ( int k = 0; k < CLASSES; k++ ) {
+                double p2 = ( bigrams[b * CLASSES + k] + SMOOTHING * p1[k] ) / ( context2 + SMOOTHING );
+                double p3 = ( trigrams[( a * CLASSES + b ) * CLASSES + k] + SMOOTHING * p2 ) / ( context3 + SMOOTHING );
+                trigram_[( a * CLASSES + b ) * CLASSES + k] = std::log( LAMBDA3 * p3 + LAMBDA2 * p2 + LAMBDA1 * p1[k] );
+            }
+        }
+    }
+}
+
+double LanguageModel::score( const char * text, size_t length ) const {
+    double sum = 0;
+    int a = START, b = START;
+    for ( size_t i = 0; i < length; i++ ) {
+        unsigned char c = text[i];
+        sum += next( a, b, c );
+        a = b;
+        b = classes_[c];
+    }
+    return sum;
+}
+
+double LanguageModel::scoreColumns( const ColumnMatrix & matrix, const std::string & crib, size_t offset ) const {
+    // One pass over the rows, contexts of all messages advance together
+    std::vector<unsigned char> a( matrix.stride(), START ), b( matrix.stride(), START );
+    double sum = 0;
+    size_t count = 0;
+    size_t end = std::min( offset + crib.size(), matrix.positions() );
+    for ( size_t p = offset; p < end; p++ ) {
+        const unsigned char * row = matrix.column( p );
+        const unsigned char * pad = matrix.padding( p );
+        unsigned char key = crib[p - offset];
+        float rowSum = 0;
+        size_t rowCount = 0;
+        for ( size_t m = 0; m < matrix.messages(); m++ ) {
+            unsigned char c = row[m] ^ key;
+            float value = trigram_[( a[m] * CLASSES + b[m] ) * CLASSES + classes_[c]] + byte_[c];
+            rowSum   += pad[m] ? 0 : value;
+            rowCount += !pad[m];
+            a[m] = b[m];
+            b[m] = classes_[c];
+        }
+        sum   += rowSum;
+        count += rowCount;
+    }
+    return count ? sum / count : 0;
+}
@@ -0,0 +1,104 @@
+#ifndef SCORE_H
+#define SCORE_H
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+#include "cribdrag.h"
+
+/*
+ * Character trigram model with all probabilities precomputed into lookup
+ * tables. Bytes are folded into 32 classes (letters without case, space,
+ * dot, comma, digit, other printable, other), log P( class | two previous
+ * classes ) is interpolated with bigram and unigram estimates ahead of time
+ * and log P( byte | class ) keeps case and exact punctuation.
+ */
+class LanguageModel {
+public:
+    static const int CLASSES = 32;
+    static const int START   = CLASSES - 1;
+
+    LanguageModel();
+
+    /*
+     * Counts text of training file, returns false when it can not be read
+     */
+    bool train( const std::string & filename );
+    void trainText( const std::string & text );
+
+    /*
+     * Log probability of fragment, context starts empty
+     */
+    double score( const char * text, size_t length ) const;
+
+    /*
+     * Mean log probability per byte of crib XORed with every message at
+     * offset, bytes past the end of a message are skipped
+     */
+    double scoreColumns( const ColumnMatrix & matrix, const std::string & crib, size_t offset ) const;
+
+    /*
+     * Log probability of byte c after classes a, b, used by incremental scoring
+     */
+    float next( int a, int b, unsigned char c ) const { return trigram_[( a * CLASSES + b ) * CLASSES + classes_[c]] + byte_[c]; }
+    int classOf( unsigned char c ) const { return classes_[c]; }
+
+    /*
+     * Log probability of byte without context, used by column-wise solvers
+     */
+    float frequency( unsigned char c ) const { return frequency_[c]; }
+
+    bool trained() const { return trained_; }
+
+private:
+    void build( const std::vector<double> & bytes, const std::vector<double> & bigrams, const std::vector<double> & trigrams );
+
+    bool               trained_;
+    unsigned char      classes_[256];
+    float              byte_[256];
+    float              frequency_[256];
+    std::vector<float> trigram_;
+};
+
+/*
+ * Keeps K best items seen, pop order is worst first
+ */
+template<typename T, typename Less = std::less<T> >
+class TopK {
+public:
+    explicit TopK( size_t k ) : k_( k ) {}
+
+    void push( const T & item ) {
+        if ( heap_.size() < k_ ) {
+            heap_.push( item );
+        }
+        else if ( k_ && Less()( heap_.top(), item ) ) {
+            heap_.pop();
+            heap_.push( item );
+        }
+    }
+
+    /*
+     * Best first
+     */
+    std::vector<T> sorted() {
+        std::vector<T> items;
+        for ( ; !heap_.empty(); heap_.pop() ) {
+            items.push_back( heap_.top() );
+        }
+        std::reverse( items.begin(), items.end() );
+        return items;
+    }
+
+private:
+    struct Greater {
+        bool operator()( const T & a, const T & b ) const { return Less()( b, a ); }
+    };
+
+    size_t                                          k_;
+    std::priority_queue<T, std::vector<T>, Greater> heap_;
+};
+
+#endif
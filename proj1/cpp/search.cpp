@@ -0,0 +1,121 @@
+#include "search.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+/*
+ * Range of task indices owned by one worker. The owner takes chunks from
+ * the front, thieves take the back half.
+ */
+struct WorkQueue {
+    std::mutex lock;
+    size_t     begin;
+    size_t     end;
+};
+
+static const size_t CHUNK = 64;
+
+static bool takeOwn( WorkQueue & queue, size_t & begin, size_t & end ) {
+    std::lock_guard<std::mutex> guard( queue.lock );
+    if ( queue.begin >= queue.end ) {
+        return false;
+    }
+    begin = queue.begin;
+    end   = std::min( queue.end, begin + CHUNK );
+    queue.begin = end;
+    return true;
+}
+
+static bool steal( std::vector<WorkQueue> & queues, size_t self, size_t & begin, size_t & end ) {
+    for ( size_t i = 1; i < queues.size(); i++ ) {
+        WorkQueue & victim = queues[( self + i ) % queues.size()];
+        std::lock_guard<std::mutex> guard( victim.lock );
+        size_t left = victim.end > victim.begin ? victim.end - victim.begin : 0;
+        if ( left == 0 ) {
+            continue;
+        }
+        size_t half = left > CHUNK ? left / 2 : left;
+        begin = victim.end - half;
+        end   = victim.end;
+        victim.end = begin;
+        return true;
+    }
+    return false;
+}
+
+double letterScore( const ColumnMatrix & matrix, const std::string & crib, size_t offset ) {
+    size_t letters = 0, total = 0;
+    for ( size_t m = 0; m < matrix.messages(); m++ ) {
+        for ( char c : cribResult( matrix, crib, offset, m ) ) {
+            letters += ( c | 0x20 ) >= 'a' && ( c | 0x20 ) <= 'z';
+            total++;
+        }
+    }
+    return total ? static_cast<double>( letters ) / total : 0;
+}
+
+/*
+ * Worse match is the one with lower score, ties prefer earlier crib and offset
+ */
+bool operator<( const CribMatch & a, const CribMatch & b ) {
+    if ( a.score != b.score ) {
+        return a.score < b.score;
+    }
+    return a.crib != b.crib ? a.crib > b.crib : a.offset > b.offset;
+}
+
+std::vector<CribMatch> searchCribs( const ColumnMatrix & matrix, const std::vector<std::string> & cribs, size_t threads,
+                                    const LanguageModel * model, size_t top ) {
+    size_t offsets = matrix.minLength();
+    size_t tasks   = cribs.size() * offsets;
+    threads = std::max<size_t>( 1, std::min( threads, tasks / CHUNK + 1 ) );
+
+    std::vector<WorkQueue> queues( threads );
+    for ( size_t i = 0; i < threads; i++ ) {
+        queues[i].begin = tasks * i / threads;
+        queues[i].end   = tasks * ( i + 1 ) / threads;
+    }
+
+    std::vector<std::vector<CribMatch> > results( threads );
+    auto worker = [&]( size_t self ) {
+        size_t begin, end;
+        TopK<CribMatch> best( top );
+        while ( takeOwn( queues[self], begin, end ) || steal( queues, self, begin, end ) ) {
+            for ( size_t task = begin; task < end; task++ ) {
+                size_t crib = task / offsets, offset = task % offsets;
+                if ( model ) {
+                    CribMatch match = { model->scoreColumns( matrix, cribs[crib], offset ), crib, offset };
+                    best.push( match );
+                }
+                else if ( cribFits( matrix, cribs[crib], offset ) ) {
+                    CribMatch match = { letterScore( matrix, cribs[crib], offset ), crib, offset };
+                    results[self].push_back( match );
+                }
+            }
+        }
+        if ( model ) {
+            results[self] = best.sorted();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for ( size_t i = 1; i < threads; i++ ) {
+        pool.push_back( std::thread( worker, i ) );
+    }
+    worker( 0 );
+    for ( std::thread & thread : pool ) {
+        thread.join();
+    }
+
+    std::vector<CribMatch> merged;
+    for ( std::vector<CribMatch> & result : results ) {
+        merged.insert( merged.end(), result.begin(), result.end() );
+    }
+    std::sort( merged.begin(), merged.end(), []( const CribMatch & a, const CribMatch & b ) {
+        return b < a;
+    } );
+    if ( model && merged.size() > top ) {
+        merged.resize( top );
+    }
+    return merged;
+}
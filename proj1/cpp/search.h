@@ -0,0 +1,35 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <string>
+#include <vector>
+#include "cribdrag.h"
+#include "score.h"
+
+/*
+ * Crib that fits at offset of every message
+ */
+struct CribMatch {
+    double score;
+    size_t crib;
+    size_t offset;
+};
+
+/*
+ * Tries every (crib, offset) pair on threads that steal work from each other,
+ * returns matches ranked by score, best first. Without model only pairs that
+ * keep every message readable are returned, scored by letterScore(). With
+ * model every pair is scored by it and top best are kept.
+ */
+std::vector<CribMatch> searchCribs( const ColumnMatrix & matrix, const std::vector<std::string> & cribs, size_t threads,
+                                    const LanguageModel * model = nullptr, size_t top = 0 );
+
+bool operator<( const CribMatch & a, const CribMatch & b );
+
+/*
+ * Share of letters in crib XORed with every message, spaces and punctuation
+ * score lower so word-like candidates come first
+ */
+double letterScore( const ColumnMatrix & matrix, const std::string & crib, size_t offset );
+
+#endif
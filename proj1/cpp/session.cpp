@@ -0,0 +1,207 @@
+#include "session.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+Session::Session( const Corpus & corpus, const LanguageModel & model, size_t threads )
+    : corpus_( corpus ), model_( model ), threads_( threads ) {
+    size_t length = 0;
+    for ( size_t i = 0; i < corpus.size(); i++ ) {
+        length = std::max( length, corpus.length( i ) );
+    }
+    key_.assign( length, -1 );
+}
+
+void Session::run( std::istream & in, std::ostream & out, bool prompt ) {
+    std::string line;
+    do {
+        if ( prompt ) {
+            out << "> " << std::flush;
+        }
+    } while ( std::getline( in, line ) && execute( line, out ) );
+}
+
+bool Session::execute( const std::string & line, std::ostream & out ) {
+    std::istringstream stream( line );
+    std::string command;
+    if ( !( stream >> command ) ) {
+        return true;
+    }
+
+    size_t a = 0, b = 0;
+    if ( command == "quit" || command == "exit" ) {
+        return false;
+    }
+    else if ( command == "crib" && stream >> a >> b && stream.get() == ' ' ) {
+        std::string text;
+        std::getline( stream, text );
+        if ( a < corpus_.size() && !text.empty() ) {
+            crib( a, b, text, out );
+            return true;
+        }
+    }
+    else if ( command == "column" && stream >> a && a < key_.size() ) {
+        column( a, out );
+        return true;
+    }
+    else if ( command == "show" ) {
+        if ( !( stream >> a ) ) {
+            for ( size_t m = 0; m < corpus_.size(); m++ ) {
+                show( m, 0, corpus_.length( m ), out );
+            }
+            return true;
+        }
+        size_t from = 0, to = a < corpus_.size() ? corpus_.length( a ) : 0;
+        if ( stream >> from ) {
+            stream >> to;
+        }
+        if ( a < corpus_.size() ) {
+            show( a, from, std::min( to, corpus_.length( a ) ), out );
+            return true;
+        }
+    }
+    else if ( command == "auto" ) {
+        double threshold = 0.9;
+        stream >> threshold;
+        automatic( threshold, out );
+        return true;
+    }
+    else if ( command == "undo" ) {
+        undo( out );
+        return true;
+    }
+    else if ( command == "key" ) {
+        key( out );
+        return true;
+    }
+    else if ( command == "export" ) {
+        std::string filename;
+        if ( stream >> filename ) {
+            out << ( exportKey( filename ) ? "written " : "unable to write " ) << filename << '\n';
+            return true;
+        }
+    }
+    else if ( command == "help" ) {
+        help( out );
+        return true;
+    }
+    out << "invalid command, try help\n";
+    return true;
+}
+
+void Session::setKey( Change & change, size_t position, int value ) {
+    if ( key_[position] != value ) {
+        change.positions.push_back( position );
+        change.previous.push_back( key_[position] );
+        key_[position] = value;
+    }
+}
+
+char Session::plain( size_t message, size_t position ) const {
+    if ( key_[position] < 0 ) {
+        return '?';
+    }
+    unsigned char c = corpus_.data( message )[position] ^ key_[position];
+    return c >= ' ' && c < 0x7f ? c : '.';
+}
+
+void Session::crib( size_t message, size_t offset, const std::string & text, std::ostream & out ) {
+    const char * cipher = corpus_.data( message );
+    size_t end = std::min( offset + text.size(), corpus_.length( message ) );
+    Change change;
+    for ( size_t p = offset; p < end; p++ ) {
+        setKey( change, p, static_cast<unsigned char>( cipher[p] ^ text[p - offset] ) );
+    }
+    out << change.positions.size() << " key bytes changed\n";
+    // Only the columns the crib covers are shown again
+    for ( size_t m = 0; m < corpus_.size() && offset < end; m++ ) {
+        show( m, offset, std::min( end, corpus_.length( m ) ), out );
+    }
+    undo_.push_back( change );
+}
+
+void Session::column( size_t position, std::ostream & out ) const {
+    out << "key ";
+    if ( key_[position] < 0 ) {
+        out << "??";
+    }
+    else {
+        out << std::hex << std::setw( 2 ) << std::setfill( '0' ) << key_[position] << std::dec << std::setfill( ' ' );
+    }
+    out << '\n';
+    for ( size_t m = 0; m < corpus_.size(); m++ ) {
+        if ( position < corpus_.length( m ) ) {
+            out << m << ": " << plain( m, position ) << '\n';
+        }
+    }
+}
+
+void Session::show( size_t message, size_t from, size_t to, std::ostream & out ) const {
+    std::string line;
+    for ( size_t p = from; p < to; p++ ) {
+        line += plain( message, p );
+    }
+    out << message << ": " << line << '\n';
+}
+
+void Session::automatic( double threshold, std::ostream & out ) {
+    if ( solved_.bytes.empty() ) {
+        solved_ = recoverKeystream( corpus_, model_, threads_ );
+    }
+    Change change;
+    for ( size_t p = 0; p < key_.size(); p++ ) {
+        if ( key_[p] < 0 && solved_.confidence[p] >= threshold ) {
+            setKey( change, p, solved_.bytes[p] );
+        }
+    }
+    out << change.positions.size() << " key bytes filled\n";
+    undo_.push_back( change );
+}
+
+void Session::undo( std::ostream & out ) {
+    if ( undo_.empty() ) {
+        out << "nothing to undo\n";
+        return;
+    }
+    const Change & change = undo_.back();
+    for ( size_t i = change.positions.size(); i-- > 0; ) {
+        key_[change.positions[i]] = change.previous[i];
+    }
+    out << change.positions.size() << " key bytes restored\n";
+    undo_.pop_back();
+}
+
+void Session::key( std::ostream & out ) const {
+    size_t known = 0;
+    for ( int byte : key_ ) {
+        if ( byte < 0 ) {
+            out << "??";
+        }
+        else {
+            out << std::hex << std::setw( 2 ) << std::setfill( '0' ) << byte << std::dec << std::setfill( ' ' );
+            known++;
+        }
+    }
+    out << '\n' << known << '/' << key_.size() << " known\n";
+}
+
+bool Session::exportKey( const std::string & filename ) const {
+    // Raw bytes the way encrypt() reads key.bin, unknown bytes are zero
+    std::ofstream file( filename, std::ios::binary );
+    for ( int byte : key_ ) {
+        file.put( static_cast<char>( byte < 0 ? 0 : byte ) );
+    }
+    return static_cast<bool>( file );
+}
+
+void Session::help( std::ostream & out ) const {
+    out << "crib MESSAGE OFFSET TEXT  set key so that MESSAGE reads TEXT at OFFSET\n"
+           "column POSITION           key byte and plaintext of every message at POSITION\n"
+           "show [MESSAGE [FROM TO]]  plaintext, ? marks unknown key bytes\n"
+           "auto [CONFIDENCE]         fill unknown key bytes solved with at least CONFIDENCE\n"
+           "undo                      revert last crib or auto\n"
+           "key                       known keystream in hex\n"
+           "export FILE               write keystream as raw bytes\n"
+           "quit\n";
+}
@@ -0,0 +1,60 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "corpus.h"
+#include "keystream.h"
+#include "score.h"
+
+/*
+ * Interactive breaking of one corpus. Keeps known keystream bytes, every
+ * command touches only the positions it names and can be undone. Plaintext
+ * is derived from the key when shown, nothing else has to be rebuilt.
+ */
+class Session {
+public:
+    Session( const Corpus & corpus, const LanguageModel & model, size_t threads );
+
+    /*
+     * Reads commands until end of input or "quit", prompt is printed when set
+     */
+    void run( std::istream & in, std::ostream & out, bool prompt );
+
+    /*
+     * Executes one command line, returns false on "quit"
+     */
+    bool execute( const std::string & line, std::ostream & out );
+
+private:
+    /*
+     * Key bytes a command changed, restored by undo
+     */
+    struct Change {
+        std::vector<size_t> positions;
+        std::vector<int>    previous;
+    };
+
+    void crib( size_t message, size_t offset, const std::string & text, std::ostream & out );
+    void column( size_t position, std::ostream & out ) const;
+    void show( size_t message, size_t from, size_t to, std::ostream & out ) const;
+    void automatic( double threshold, std::ostream & out );
+    void undo( std::ostream & out );
+    void key( std::ostream & out ) const;
+    bool exportKey( const std::string & filename ) const;
+    void help( std::ostream & out ) const;
+
+    void setKey( Change & change, size_t position, int value );
+    char plain( size_t message, size_t position ) const;
+
+    const Corpus &        corpus_;
+    const LanguageModel & model_;
+    size_t                threads_;
+    std::vector<int>      key_;   // -1 where unknown
+    std::vector<Change>   undo_;
+    Keystream             solved_; // column solution, computed on first auto
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "synthetic.h"
+#include "base64.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+static const size_t BUFFER_SIZE = 1 << 22;
+
+SyntheticCorpus::SyntheticCorpus() : bigram_( 256 * 256, 0 ), length_( 0 ), jitter_( 0 ), model_( SYNTHETIC_WORDS ) {}
+
+bool SyntheticCorpus::train( const std::string & filename ) {
+    std::ifstream file( filename, std::ios::binary );
+    std::stringstream content;
+    content << file.rdbuf();
+    std::string text = content.str();
+    bool ok = file.is_open() && !text.empty();
+    if ( !ok ) {
+        text = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ.,";
+    }
+
+    std::istringstream tokens( text );
+    std::string word;
+    words_.clear();
+    while ( tokens >> word ) {
+        words_.push_back( word );
+    }
+
+    // Lines are joined by spaces, the chain never produces a newline
+    std::replace( text.begin(), text.end(), '\n', ' ' );
+    std::fill( bigram_.begin(), bigram_.end(), 0 );
+    for ( size_t i = 1; i < text.size(); i++ ) {
+        bigram_[static_cast<unsigned char>( text[i - 1] ) * 256 + static_cast<unsigned char>( text[i] )]++;
+    }
+    for ( size_t row = 0; row < 256; row++ ) {
+        for ( size_t c = 1; c < 256; c++ ) {
+            bigram_[row * 256 + c] += bigram_[row * 256 + c - 1];
+        }
+    }
+    return ok;
+}
+
+void SyntheticCorpus::configure( size_t length, size_t jitter, SyntheticModel model, unsigned seed ) {
+    length_ = length;
+    jitter_ = jitter;
+    model_  = model;
+    random_.seed( seed );
+    key_.resize( length + jitter );
+    for ( char & c : key_ ) {
+        c = random_();
+    }
+}
+
+void SyntheticCorpus::plaintext( std::string & text ) {
+    size_t length = length_ + ( jitter_ ? random_() % ( jitter_ + 1 ) : 0 );
+    text.clear();
+    if ( model_ == SYNTHETIC_WORDS ) {
+        while ( text.size() < length ) {
+            if ( !text.empty() ) {
+                text += ' ';
+            }
+            text += words_[random_() % words_.size()];
+        }
+        text.resize( length );
+        return;
+    }
+
+    unsigned char previous = ' ';
+    while ( text.size() < length ) {
+        const unsigned * row = bigram_.data() + previous * 256;
+        if ( row[255] == 0 ) {
+            row = bigram_.data() + ' ' * 256;
+        }
+        if ( row[255] == 0 ) {
+            previous = 'a' + random_() % 26;
+        }
+        else {
+            previous = std::upper_bound( row, row + 256, random_() % row[255] ) - row;
+        }
+        text += previous;
+    }
+}
+
+bool SyntheticCorpus::write( FILE * file, size_t count ) {
+    std::vector<char> buffer( BUFFER_SIZE );
+    std::string text;
+    size_t used = 0;
+    for ( size_t m = 0; m < count; m++ ) {
+        plaintext( text );
+        for ( size_t i = 0; i < text.size(); i++ ) {
+            text[i] ^= key_[i];
+        }
+        if ( buffer.size() - used < base64_encode_bound( text.size() ) + 1 ) {
+            if ( std::fwrite( buffer.data(), 1, used, file ) != used ) {
+                return false;
+            }
+            used = 0;
+        }
+        used += base64_encode( text.data(), text.size(), buffer.data() + used );
+        buffer[used++] = '\n';
+    }
+    return std::fwrite( buffer.data(), 1, used, file ) == used;
+}
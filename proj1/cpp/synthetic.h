@@ -0,0 +1,58 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Plaintext model used to generate messages
+ */
+enum SyntheticModel { SYNTHETIC_WORDS, SYNTHETIC_BIGRAM };
+
+/*
+ * Many-time-pad corpus generator. Plaintexts are either words drawn from
+ * the source text, which is what proj1/result.txt looks like, or a byte
+ * bigram chain trained on it. All messages are XORed with one random
+ * keystream and written as base64 lines.
+ */
+class SyntheticCorpus {
+public:
+    SyntheticCorpus();
+
+    /*
+     * Trains both models on text of file, falls back to built in letters
+     * when it can not be read
+     */
+    bool train( const std::string & filename );
+
+    /*
+     * Messages of length to length + jitter bytes, key is long enough for
+     * all of them
+     */
+    void configure( size_t length, size_t jitter, SyntheticModel model, unsigned seed );
+
+    /*
+     * Writes count messages to file, false on write error
+     */
+    bool write( FILE * file, size_t count );
+
+    /*
+     * Plaintext of next message, exposed so tests can check recovery
+     */
+    void plaintext( std::string & text );
+
+    const std::string & key() const { return key_; }
+
+private:
+    std::vector<std::string> words_;
+    std::vector<unsigned>    bigram_;  // cumulative counts, 256 rows of 256
+    size_t                   length_;
+    size_t                   jitter_;
+    SyntheticModel           model_;
+    std::mt19937             random_;
+    std::string              key_;
+};
+
+#endif
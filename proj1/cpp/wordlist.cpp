@@ -0,0 +1,115 @@
+#include "wordlist.h"
+#include <fstream>
+
+const int      WordAutomaton::SYMBOLS;
+const int      WordAutomaton::BOUNDARY;
+const uint32_t WordAutomaton::ROOT;
+
+WordAutomaton::WordAutomaton() {
+    for ( int c = 0; c < 256; c++ ) {
+        int lower = c | 0x20;
+        symbols_[c] = lower >= 'a' && lower <= 'z' ? lower - 'a' : BOUNDARY;
+    }
+    build( std::vector<std::string>() );
+}
+
+bool WordAutomaton::load( const std::string & filename ) {
+    std::ifstream file( filename );
+    if ( !file.is_open() ) {
+        return false;
+    }
+    std::vector<std::string> words;
+    std::string word;
+    while ( file >> word ) {
+        words.push_back( word );
+    }
+    build( words );
+    return true;
+}
+
+void WordAutomaton::build( const std::vector<std::string> & words ) {
+    next_.assign( SYMBOLS, ROOT );
+    depth_.assign( 1, 0 );
+    word_.assign( 1, 0 );
+    hits_.assign( 1, 0 );
+
+    // Trie first, missing transitions stay ROOT
+    for ( const std::string & w : words ) {
+        uint32_t state = ROOT;
+        bool letters = !w.empty() && w.size() < 0xffff;
+        for ( unsigned char c : w ) {
+            letters = letters && symbols_[c] != BOUNDARY;
+        }
+        if ( !letters ) {
+            continue;
+        }
+        for ( unsigned char c : w ) {
+            size_t edge = ( state << 5 ) + symbols_[c];
+            if ( next_[edge] == ROOT ) {
+                next_[edge] = depth_.size();
+                next_.resize( next_.size() + SYMBOLS, ROOT );
+                depth_.push_back( depth_[state] + 1 );
+                word_.push_back( 0 );
+                hits_.push_back( 0 );
+            }
+            state = next_[edge];
+        }
+        if ( !word_[state] ) {
+            word_[state] = 1;
+            hits_[state] = 1;
+        }
+    }
+
+    // Breadth first over the trie, failure links turn it into a full DFA.
+    // Trie edges are recognized by depth, links of a state are final before its children.
+    std::vector<uint32_t> fail( depth_.size(), ROOT ), queue;
+    for ( int s = 0; s < SYMBOLS; s++ ) {
+        if ( next_[s] != ROOT ) {
+            queue.push_back( next_[s] );
+        }
+    }
+    for ( size_t head = 0; head < queue.size(); head++ ) {
+        uint32_t state = queue[head];
+        hits_[state] += hits_[fail[state]];
+        for ( int s = 0; s < SYMBOLS; s++ ) {
+            uint32_t & target = next_[( state << 5 ) + s];
+            if ( target != ROOT && depth_[target] == depth_[state] + 1 ) {
+                fail[target] = next_[( fail[state] << 5 ) + s];
+                queue.push_back( target );
+            }
+            else {
+                target = next_[( fail[state] << 5 ) + s];
+            }
+        }
+    }
+}
+
+WordScore WordAutomaton::scan( const char * text, size_t length ) const {
+    WordScore score = { 0, 0, 0, 0 };
+    uint32_t state = ROOT;
+    size_t run = 0;
+    bool bounded = false; // current run has a boundary on its left
+    for ( size_t i = 0; i < length; i++ ) {
+        int s = symbols_[static_cast<unsigned char>( text[i] )];
+        if ( s == BOUNDARY ) {
+            if ( bounded && run ) {
+                bool whole = depth_[state] == run && word_[state];
+                score.words   += whole;
+                score.invalid += !whole;
+            }
+            score.boundaries++;
+            state   = ROOT;
+            run     = 0;
+            bounded = true;
+            continue;
+        }
+        state = next_[( state << 5 ) + s];
+        score.hits += hits_[state];
+        run++;
+    }
+    // Unfinished run has to be at least the start of some word
+    if ( bounded && run && depth_[state] != run ) {
+        score.invalid++;
+    }
+    return score;
+}
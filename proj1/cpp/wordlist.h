@@ -0,0 +1,62 @@
+#ifndef WORDLIST_H
+#define WORDLIST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Result of scanning one fragment. A run is a maximal sequence of letters,
+ * it is complete when a boundary is on both of its sides inside the fragment.
+ */
+struct WordScore {
+    size_t hits;       // dictionary words found anywhere, overlaps included
+    size_t words;      // complete runs that are dictionary words
+    size_t boundaries; // non-letter bytes
+    size_t invalid;    // complete runs that are not words, trailing runs that start no word
+};
+
+/*
+ * Aho-Corasick automaton of a wordlist. Letters are folded to 26 lower
+ * case symbols, transitions of all states are precomputed into one flat
+ * table with 32 entries per state, so scanning is one lookup per byte.
+ * Any other byte is a word boundary and returns to the root.
+ */
+class WordAutomaton {
+public:
+    static const int SYMBOLS = 32;
+    static const int BOUNDARY = -1;
+    static const uint32_t ROOT = 0;
+
+    WordAutomaton();
+
+    /*
+     * Loads whitespace separated words, returns false when file can not be read
+     */
+    bool load( const std::string & filename );
+    void build( const std::vector<std::string> & words );
+
+    WordScore scan( const char * text, size_t length ) const;
+
+    /*
+     * Symbol of byte, BOUNDARY for anything but letters
+     */
+    int symbol( unsigned char c ) const { return symbols_[c]; }
+
+    uint32_t next( uint32_t state, int symbol ) const { return next_[( state << 5 ) + symbol]; }
+    size_t depth( uint32_t state ) const { return depth_[state]; }
+    bool   word( uint32_t state ) const { return word_[state]; }   // state spells a whole word
+    size_t hits( uint32_t state ) const { return hits_[state]; }   // words ending in state
+
+    size_t states() const { return depth_.size(); }
+    bool   empty()  const { return depth_.size() <= 1; }
+
+private:
+    signed char                symbols_[256];
+    std::vector<uint32_t>      next_;
+    std::vector<uint16_t>      depth_;
+    std::vector<unsigned char> word_;
+    std::vector<uint32_t>      hits_;
+};
+
+#endif
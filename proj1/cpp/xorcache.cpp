@@ -0,0 +1,204 @@
+#include "xorcache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char   MAGIC[4]    = { 'B', 'R', 'X', 'C' };
+static const size_t VERSION     = 1;
+static const size_t HEADER_SIZE = 48;
+static const size_t RECORD_SIZE = 12;
+static const size_t BLOCK_SIZE  = 1 << 20;
+
+static uint64_t readLittle( const unsigned char * data, size_t bytes ) {
+    uint64_t value = 0;
+    for ( size_t i = bytes; i-- > 0; ) {
+        value = ( value << 8 ) | data[i];
+    }
+    return value;
+}
+
+static void writeLittle( unsigned char * data, uint64_t value, size_t bytes ) {
+    for ( size_t i = 0; i < bytes; i++ ) {
+        data[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+std::string xorCacheName( const std::string & corpusFile ) {
+    return corpusFile + ".xor";
+}
+
+XorCache::XorCache() : corpus_( nullptr ), map_( nullptr ), mapLength_( 0 ), valid_( 0 ), blockUsed_( 0 ), cached_( 0 ), computed_( 0 ) {}
+
+XorCache::~XorCache() {
+    close();
+}
+
+void XorCache::close() {
+    if ( map_ ) {
+        munmap( const_cast<unsigned char *>( map_ ), mapLength_ );
+    }
+    map_       = nullptr;
+    mapLength_ = 0;
+    valid_     = 0;
+}
+
+bool XorCache::open( const Corpus & corpus, const std::string & corpusFile, const std::string & cacheFile ) {
+    close();
+    corpus_   = &corpus;
+    file_     = cacheFile;
+    cached_   = computed_ = 0;
+    pending_.clear();
+    pairs_.clear();
+
+    size_t bytes = 0, longest = 0;
+    for ( size_t i = 0; i < corpus.size(); i++ ) {
+        bytes  += corpus.length( i );
+        longest = std::max( longest, corpus.length( i ) );
+    }
+    zeros_.assign( longest + 1, 0 );
+    struct stat info;
+    if ( stat( corpusFile.c_str(), &info ) != 0 ) {
+        file_.clear();
+        return false;
+    }
+    header_.assign( HEADER_SIZE, 0 );
+    std::memcpy( header_.data(), MAGIC, 4 );
+    writeLittle( header_.data() + 4, VERSION, 4 );
+    writeLittle( header_.data() + 8, info.st_size, 8 );
+    writeLittle( header_.data() + 16, info.st_mtim.tv_sec, 8 );
+    writeLittle( header_.data() + 24, info.st_mtim.tv_nsec, 8 );
+    writeLittle( header_.data() + 32, corpus.size(), 8 );
+    writeLittle( header_.data() + 40, bytes, 8 );
+
+    int fd = ::open( file_.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        return true;
+    }
+    if ( fstat( fd, &info ) != 0 || static_cast<size_t>( info.st_size ) < HEADER_SIZE ) {
+        ::close( fd );
+        return true;
+    }
+    void * map = mmap( nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( map == MAP_FAILED ) {
+        return true;
+    }
+    map_       = static_cast<const unsigned char *>( map );
+    mapLength_ = info.st_size;
+    if ( std::memcmp( map_, header_.data(), HEADER_SIZE ) != 0 ) {
+        close();
+        return true;
+    }
+
+    // Torn record at the end of the log is dropped and overwritten later
+    size_t offset = HEADER_SIZE;
+    while ( mapLength_ - offset >= RECORD_SIZE ) {
+        size_t i = readLittle( map_ + offset, 4 ), j = readLittle( map_ + offset + 4, 4 );
+        size_t length = readLittle( map_ + offset + 8, 4 );
+        if ( i >= j || j >= corpus.size() || length != this->length( i, j ) || mapLength_ - offset - RECORD_SIZE < length ) {
+            break;
+        }
+        const unsigned char *& cached = pairs_[key( i, j )];
+        if ( !cached ) {
+            cached_++;
+        }
+        cached = map_ + offset + RECORD_SIZE;
+        offset += RECORD_SIZE + length;
+    }
+    valid_ = offset;
+    return true;
+}
+
+uint64_t XorCache::key( size_t i, size_t j ) {
+    return static_cast<uint64_t>( i ) << 32 | j;
+}
+
+size_t XorCache::length( size_t i, size_t j ) const {
+    return std::min( corpus_->length( i ), corpus_->length( j ) );
+}
+
+unsigned char * XorCache::allocate( size_t length ) {
+    if ( blocks_.empty() || blocks_.back().size() - blockUsed_ < length ) {
+        blocks_.push_back( std::vector<unsigned char>( std::max( BLOCK_SIZE, length ) ) );
+        blockUsed_ = 0;
+    }
+    unsigned char * result = blocks_.back().data() + blockUsed_;
+    blockUsed_ += length;
+    return result;
+}
+
+const unsigned char * XorCache::pair( size_t i, size_t j ) {
+    if ( i == j ) {
+        return zeros_.data();
+    }
+    if ( i > j ) {
+        std::swap( i, j );
+    }
+    const unsigned char *& cached = pairs_[key( i, j )];
+    if ( !cached ) {
+        size_t size = length( i, j );
+        unsigned char * result = allocate( size );
+        const char * a = corpus_->data( i );
+        const char * b = corpus_->data( j );
+        for ( size_t p = 0; p < size; p++ ) {
+            result[p] = a[p] ^ b[p];
+        }
+        cached = result;
+        pending_.push_back( i );
+        pending_.push_back( j );
+        computed_++;
+    }
+    return cached;
+}
+
+bool XorCache::flush() {
+    if ( file_.empty() || pending_.empty() ) {
+        return true;
+    }
+    FILE * file = nullptr;
+    if ( valid_ >= HEADER_SIZE ) {
+        // Appends after the last good record, torn tail is cut off first
+        file = std::fopen( file_.c_str(), "r+b" );
+        if ( file && ( ftruncate( fileno( file ), valid_ ) != 0 || std::fseek( file, valid_, SEEK_SET ) != 0 ) ) {
+            std::fclose( file );
+            file = nullptr;
+        }
+    }
+    else {
+        file = std::fopen( file_.c_str(), "wb" );
+        if ( file && std::fwrite( header_.data(), 1, HEADER_SIZE, file ) != HEADER_SIZE ) {
+            std::fclose( file );
+            file = nullptr;
+        }
+        valid_ = file ? HEADER_SIZE : 0;
+    }
+    if ( !file ) {
+        return false;
+    }
+
+    std::vector<unsigned char> buffer;
+    bool ok = true;
+    for ( size_t k = 0; k < pending_.size() && ok; k += 2 ) {
+        size_t i = pending_[k], j = pending_[k + 1], size = length( i, j );
+        unsigned char record[RECORD_SIZE];
+        writeLittle( record, i, 4 );
+        writeLittle( record + 4, j, 4 );
+        writeLittle( record + 8, size, 4 );
+        buffer.insert( buffer.end(), record, record + RECORD_SIZE );
+        const unsigned char * data = pairs_[key( i, j )];
+        buffer.insert( buffer.end(), data, data + size );
+        if ( buffer.size() >= BLOCK_SIZE || k + 2 == pending_.size() ) {
+            ok = std::fwrite( buffer.data(), 1, buffer.size(), file ) == buffer.size();
+            valid_ += buffer.size();
+            buffer.clear();
+        }
+    }
+    ok = std::fclose( file ) == 0 && ok;
+    pending_.clear();
+    return ok;
+}
@@ -0,0 +1,80 @@
+#ifndef XORCACHE_H
+#define XORCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "corpus.h"
+
+/*
+ * Pairwise XOR of messages, computed on first use and kept for the next run.
+ *
+ * Pairs are symmetric, only i < j is stored, each as min( length i, length j )
+ * bytes. Cache file next to the corpus is an append log, all integers little
+ * endian:
+ *   char[4]  magic "BRXC"
+ *   uint32   version
+ *   uint64   corpus file size, mtime seconds, mtime nanoseconds
+ *   uint64   number of messages, total decoded bytes
+ *   records: uint32 i, uint32 j, uint32 length, length bytes
+ * Log is memory mapped on open and pairs point straight into it, new pairs
+ * go to a block arena and are appended by flush(). Only pairs that were
+ * computed are indexed, a crib drag touches one row of N pairs per reference,
+ * so memory grows with the work done and not with N^2. Header that does not
+ * match the corpus throws the old log away.
+ */
+class XorCache {
+public:
+    XorCache();
+    ~XorCache();
+
+    /*
+     * Maps cache file of corpus loaded from corpusFile, returns false when
+     * the cache file can not be used, pairs are still computed in memory
+     */
+    bool open( const Corpus & corpus, const std::string & corpusFile, const std::string & cacheFile );
+
+    /*
+     * Message i XORed with message j, pair( i, j ) and pair( j, i ) are the same
+     */
+    const unsigned char * pair( size_t i, size_t j );
+    size_t length( size_t i, size_t j ) const;
+
+    /*
+     * Appends pairs computed since open or last flush, false on write error
+     */
+    bool flush();
+
+    size_t cached()   const { return cached_; }
+    size_t computed() const { return computed_; }
+
+private:
+    XorCache( const XorCache & );
+    XorCache & operator=( const XorCache & );
+
+    static uint64_t key( size_t i, size_t j );
+    unsigned char * allocate( size_t length );
+    void close();
+
+    const Corpus *                            corpus_;
+    std::string                               file_;
+    std::vector<unsigned char>                header_;
+    std::vector<unsigned char>                zeros_;
+    const unsigned char *                     map_;
+    size_t                                    mapLength_;
+    size_t                                    valid_;  // bytes of log that parsed
+    std::unordered_map<uint64_t, const unsigned char *> pairs_;
+    std::vector<std::vector<unsigned char> >  blocks_;
+    size_t                                    blockUsed_;
+    std::vector<uint32_t>                     pending_;
+    size_t                                    cached_;
+    size_t                                    computed_;
+};
+
+/*
+ * Cache file used for corpus file
+ */
+std::string xorCacheName( const std::string & corpusFile );
+
+#endif
@@ -0,0 +1,199 @@
+#include "xorstream.h"
+#include "base64.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Multiple of 3 so chunks of a message encode without padding in between
+static const size_t CHUNK       = 3 << 14;
+static const size_t OUTPUT_SIZE = 1 << 22;
+static const size_t LANE        = 64;
+
+/*
+ * Read only memory mapped file, empty file is not mapped
+ */
+class MappedFile {
+public:
+    MappedFile() : data_( nullptr ), length_( 0 ) {}
+    ~MappedFile() {
+        if ( data_ ) {
+            munmap( const_cast<unsigned char *>( data_ ), length_ );
+        }
+    }
+
+    bool open( const std::string & filename ) {
+        int fd = ::open( filename.c_str(), O_RDONLY );
+        if ( fd < 0 ) {
+            return false;
+        }
+        struct stat info;
+        if ( fstat( fd, &info ) != 0 ) {
+            ::close( fd );
+            return false;
+        }
+        length_ = info.st_size;
+        if ( length_ ) {
+            void * map = mmap( nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( map == MAP_FAILED ) {
+                ::close( fd );
+                return false;
+            }
+            madvise( map, length_, MADV_SEQUENTIAL );
+            data_ = static_cast<const unsigned char *>( map );
+        }
+        ::close( fd );
+        return true;
+    }
+
+    const unsigned char * data() const { return data_; }
+    size_t length() const { return length_; }
+
+private:
+    MappedFile( const MappedFile & );
+    MappedFile & operator=( const MappedFile & );
+
+    const unsigned char * data_;
+    size_t                length_;
+};
+
+/*
+ * Key repeated to keyLength + 64 bytes, so 64 bytes from any phase are contiguous
+ */
+static std::vector<unsigned char> extendKey( const unsigned char * key, size_t keyLength ) {
+    std::vector<unsigned char> extended( keyLength + LANE );
+    for ( size_t i = 0; i < extended.size(); i++ ) {
+        extended[i] = key[i % keyLength];
+    }
+    return extended;
+}
+
+static void xorScalar( const unsigned char * in, size_t length, const unsigned char * extended, size_t keyLength, size_t phase,
+                       unsigned char * out ) {
+    for ( size_t i = 0; i < length; i++ ) {
+        out[i] = in[i] ^ extended[phase];
+        if ( ++phase == keyLength ) {
+            phase = 0;
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void xorAvx2( const unsigned char * in, size_t length, const unsigned char * extended, size_t keyLength, size_t phase,
+                     unsigned char * out ) {
+    size_t i = 0;
+    for ( ; i + LANE <= length; i += LANE ) {
+        const __m256i * k = reinterpret_cast<const __m256i *>( extended + phase );
+        const __m256i * a = reinterpret_cast<const __m256i *>( in + i );
+        __m256i * o = reinterpret_cast<__m256i *>( out + i );
+        __m256i low  = _mm256_xor_si256( _mm256_loadu_si256( a ), _mm256_loadu_si256( k ) );
+        __m256i high = _mm256_xor_si256( _mm256_loadu_si256( a + 1 ), _mm256_loadu_si256( k + 1 ) );
+        _mm256_storeu_si256( o, low );
+        _mm256_storeu_si256( o + 1, high );
+        phase += LANE;
+        if ( phase >= keyLength ) {
+            phase %= keyLength;
+        }
+    }
+    xorScalar( in + i, length - i, extended, keyLength, phase, out + i );
+}
+
+static bool avx2Supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+}
+
+typedef void ( *XorKernel )( const unsigned char *, size_t, const unsigned char *, size_t, size_t, unsigned char * );
+
+static XorKernel xorKernel = avx2Supported() ? xorAvx2 : xorScalar;
+
+bool xorStreamUseAvx2( bool enable ) {
+    if ( enable && !avx2Supported() ) {
+        return false;
+    }
+    xorKernel = enable ? xorAvx2 : xorScalar;
+    return true;
+}
+
+void xorCyclic( const unsigned char * in, size_t length, const unsigned char * key, size_t keyLength, size_t phase,
+                unsigned char * out ) {
+    std::vector<unsigned char> extended = extendKey( key, keyLength );
+    xorKernel( in, length, extended.data(), keyLength, phase % keyLength, out );
+}
+
+/*
+ * Output buffer written with one large write when full
+ */
+class Output {
+public:
+    explicit Output( FILE * file ) : file_( file ), buffer_( OUTPUT_SIZE ), used_( 0 ), ok_( true ) {}
+
+    /*
+     * Room for at least length bytes, flushes first when needed
+     */
+    char * reserve( size_t length ) {
+        if ( buffer_.size() - used_ < length ) {
+            flush();
+        }
+        return buffer_.data() + used_;
+    }
+
+    void commit( size_t length ) { used_ += length; }
+
+    bool flush() {
+        if ( used_ && std::fwrite( buffer_.data(), 1, used_, file_ ) != used_ ) {
+            ok_ = false;
+        }
+        used_ = 0;
+        return ok_;
+    }
+
+private:
+    FILE *            file_;
+    std::vector<char> buffer_;
+    size_t            used_;
+    bool              ok_;
+};
+
+bool xorStream( const std::string & keyFile, const std::string & messagesFile, FILE * out, XorStreamStats & stats ) {
+    stats.messages = stats.bytes = 0;
+    stats.seconds  = 0;
+    MappedFile key, messages;
+    if ( !key.open( keyFile ) || !messages.open( messagesFile ) || key.length() == 0 ) {
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<unsigned char> extended = extendKey( key.data(), key.length() );
+    std::vector<unsigned char> scratch( CHUNK );
+    Output output( out );
+    const unsigned char * data = messages.data();
+    size_t size = messages.length();
+
+    // Every line is one message, the same split Corpus::load() does
+    for ( size_t pos = 0; pos < size; ) {
+        const unsigned char * newline = static_cast<const unsigned char *>( std::memchr( data + pos, '\n', size - pos ) );
+        size_t end = newline ? newline - data : size;
+        size_t stop = end > pos && data[end - 1] == '\r' ? end - 1 : end;
+
+        for ( size_t from = pos; from < stop; from += CHUNK ) {
+            size_t length = std::min( CHUNK, stop - from );
+            xorKernel( data + from, length, extended.data(), key.length(), ( from - pos ) % key.length(), scratch.data() );
+            char * text = output.reserve( base64_encode_bound( length ) );
+            output.commit( base64_encode( reinterpret_cast<const char *>( scratch.data() ), length, text ) );
+        }
+        *output.reserve( 1 ) = '\n';
+        output.commit( 1 );
+        stats.messages++;
+        stats.bytes += stop - pos;
+        pos = end + 1;
+    }
+
+    bool ok = output.flush();
+    stats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    return ok;
+}
@@ -0,0 +1,35 @@
+#ifndef XORSTREAM_H
+#define XORSTREAM_H
+
+#include <cstdio>
+#include <string>
+
+/*
+ * Throughput of one xorStream() run
+ */
+struct XorStreamStats {
+    size_t messages;
+    size_t bytes;    // plaintext bytes XORed
+    double seconds;
+};
+
+/*
+ * Encrypts every line of messagesFile with keystream from keyFile, writes
+ * one base64 line per message to out. Both files are memory mapped, key
+ * repeats for messages longer than it. Returns false when a file can not
+ * be read or the key is empty.
+ */
+bool xorStream( const std::string & keyFile, const std::string & messagesFile, FILE * out, XorStreamStats & stats );
+
+/*
+ * XORs length bytes of in with key starting at key phase, out may be in
+ */
+void xorCyclic( const unsigned char * in, size_t length, const unsigned char * key, size_t keyLength, size_t phase,
+                unsigned char * out );
+
+/*
+ * Selects AVX2 kernel when available, returns false when forced but unsupported
+ */
+bool xorStreamUseAvx2( bool enable );
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ * Microbenchmarks of kry primitives, run as ./bench [ --csv ] [ --filter text ] [ --min-time ms ] [ --siqs ]
+ *
+ * Every benchmark reseeds the random generator, so inputs and generated keys
+ * are the same on every run. CSV rows "name,param,iterations,ns_per_op" are
+ * read by bench_compare.sh. Quadratic sieve runs at 50 to 80 digits take minutes,
+ * so they are left out unless --siqs is given.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <unistd.h>
+#include "keygen.h"
+#include "kry.h"
+#include "primepool.h"
+#include "siqs.h"
+#include "smallmod.h"
+
+typedef std::chrono::steady_clock Clock;
+
+const unsigned long SEED = 20180417;
+const size_t        POOL = 16;
+const size_t        KEYS = 16;
+
+// Key generation varies a lot from key to key, slow rows average at least this many operations
+const size_t MIN_ITERATIONS = 31;
+
+// Relations sieved per siqsRelations operation
+const size_t SIQS_CHECK_RELATIONS = 20;
+
+struct Options {
+    bool        csv;
+    std::string filter;
+    double      minTime;
+    bool        siqs;
+};
+
+/*
+ * Runs body in growing batches until minimal time elapses and at least
+ * minIterations ran, body gets iteration index
+ */
+void run( const Options & options, const std::string & name, size_t param, const std::function<void( size_t )> & body,
+          size_t minIterations = MIN_ITERATIONS ) {
+    std::string full = name + "/" + std::to_string( param );
+    if ( full.find( options.filter ) == std::string::npos ) {
+        return;
+    }
+
+    size_t iterations = 0, batch = 1;
+    double elapsed = 0;
+    while ( elapsed < options.minTime || iterations < minIterations ) {
+        Clock::time_point start = Clock::now();
+        for ( size_t i = 0; i < batch; i++ ) {
+            body( iterations + i );
+        }
+        elapsed += std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+        iterations += batch;
+        batch *= 2;
+    }
+
+    double perOp = elapsed / iterations;
+    if ( options.csv ) {
+        std::cout << name << ',' << param << ',' << iterations << ',' << std::fixed << std::setprecision( 1 ) << perOp << std::endl;
+    }
+    else {
+        std::cout << std::left << std::setw( 28 ) << full << std::right << std::setw( 10 ) << iterations
+                  << std::setw( 18 ) << std::fixed << std::setprecision( 1 ) << perOp << " ns/op" << std::endl;
+    }
+}
+
+/*
+ * Pool of random numbers with exact bit size, optionally rounded up to primes
+ */
+MpzList pool( size_t bits, bool prime = false ) {
+    MpzList list( POOL );
+    for ( Mpz & num : list ) {
+        randomNumber( num.v, bits, prime );
+        if ( prime ) {
+            mpz_nextprime( num.v, num.v );
+        }
+    }
+    return list;
+}
+
+/*
+ * Key with given number of primes generated from the seeded generator
+ */
+void makeKey( size_t bits, size_t k, MpzList & primes, mpz_t & n, mpz_t & e, mpz_t & d ) {
+    mpz_set_ui( e, DEFAULT_E );
+    generate_key( bits, k, primes, n, e, d );
+}
+
+/*
+ * Balanced semiprime with given number of decimal digits from the seeded generator
+ */
+void semiprime( mpz_t & n, size_t digits ) {
+    mpz_t p, q, low, high;
+    mpz_inits( p, q, low, high, nullptr );
+    mpz_ui_pow_ui( low, 10, digits - 1 );
+    mpz_mul_ui( high, low, 10 );
+    size_t bits = ( mpz_sizeinbase( low, 2 ) + 2 ) / 2;
+    do {
+        randomNumber( p, bits );
+        mpz_setbit( p, bits - 1 );
+        mpz_nextprime( p, p );
+        randomNumber( q, bits );
+        mpz_setbit( q, bits - 1 );
+        mpz_nextprime( q, q );
+        mpz_mul( n, p, q );
+    } while ( mpz_cmp( n, low ) < 0 || mpz_cmp( n, high ) >= 0 );
+    mpz_clears( p, q, low, high, nullptr );
+}
+
+void benchArithmetic( const Options & options ) {
+    mpz_t result;
+    mpz_init( result );
+    for ( size_t bits : { 64, 128, 256, 512, 1024, 2048 } ) {
+        setRandomSeed( SEED );
+        MpzList a = pool( bits ), b = pool( bits ), m = pool( bits, true );
+        run( options, "powm", bits, [&]( size_t i ) {
+            powm( result, a[i % POOL].v, b[i % POOL].v, m[i % POOL].v );
+        } );
+        run( options, "invert", bits, [&]( size_t i ) {
+            invert( result, a[i % POOL].v, m[i % POOL].v );
+        } );
+        run( options, "gcd", bits, [&]( size_t i ) {
+            gcd( result, a[i % POOL].v, b[i % POOL].v );
+        } );
+    }
+    mpz_clear( result );
+}
+
+void benchPrimes( const Options & options ) {
+    mpz_t n, e, d;
+    mpz_inits( n, e, d, nullptr );
+    for ( size_t bits : { 64, 128, 256, 512, 1024 } ) {
+        setRandomSeed( SEED );
+        MpzList primes;
+        makeKey( 2 * bits, 2, primes, n, e, d );
+        run( options, "isPrime", bits, [&]( size_t ) {
+            isPrime( primes[0].v, bits );
+        } );
+    }
+    for ( size_t bits : { 256, 512, 1024 } ) {
+        setRandomSeed( SEED );
+        run( options, "generate_key", bits, [&]( size_t ) {
+            MpzList primes;
+            makeKey( bits, 2, primes, n, e, d );
+        } );
+    }
+    // One operation writes KEYS keys, compare with KEYS times generate_key
+    for ( size_t bits : { 512, 1024 } ) {
+        setRandomSeed( SEED );
+        mpz_set_ui( e, DEFAULT_E );
+        run( options, "generateKeys", bits, [&]( size_t ) {
+            generateKeys( bits, 2, KEYS, e, "/dev/null", false );
+        } );
+    }
+    // Popped primes go back to the pool, so only pool access and computeKeys are timed,
+    // pools live in a private directory of their own to keep those of the user intact
+    char poolDir[] = "/tmp/kry-bench-XXXXXX";
+    bool pooled = mkdtemp( poolDir ) && setenv( "KRY_POOL", poolDir, 1 ) == 0;
+    for ( size_t bits : { 512, 1024 } ) {
+        setRandomSeed( SEED );
+        PrimePool primePool;
+        if ( !pooled || primePool.open( bits / 2, true, POOL ) != SUCCESS ) {
+            std::cerr << "Unable to open prime pool in " << poolDir << std::endl;
+            break;
+        }
+        while ( primePool.size() < POOL ) {
+            randomPrime( n, bits / 2, e );
+            primePool.push( n );
+        }
+        run( options, "generateKeyPooled", bits, [&]( size_t ) {
+            MpzList primes;
+            generateKeyPooled( bits, 2, primes, n, e, d );
+            primePool.push( primes[0].v );
+            primePool.push( primes[1].v );
+        } );
+        unlink( primePool.path().c_str() );
+    }
+    if ( pooled ) {
+        rmdir( poolDir );
+    }
+    for ( size_t k : { 3, 4 } ) {
+        setRandomSeed( SEED );
+        run( options, "generate_key_k" + std::to_string( k ), 1024, [&]( size_t ) {
+            MpzList primes;
+            makeKey( 1024, k, primes, n, e, d );
+        } );
+    }
+    mpz_clears( n, e, d, nullptr );
+}
+
+/*
+ * Returns false when CRT decryption disagrees with plain decryption
+ */
+bool benchCipher( const Options & options ) {
+    mpz_t n, e, d, wide, result, expected;
+    mpz_inits( n, e, d, wide, result, expected, nullptr );
+    for ( size_t bits : { 512, 1024, 2048 } ) {
+        for ( size_t k : { 2, 3, 4 } ) {
+            setRandomSeed( SEED );
+            MpzList primes;
+            makeKey( bits, k, primes, n, e, d );
+            MpzList messages = pool( bits );
+            for ( Mpz & message : messages ) {
+                mpz_mod( message.v, message.v, n );
+            }
+
+            CrtKey key;
+            prepareCrt( key, primes, d );
+            for ( const Mpz & message : messages ) {
+                decrypt( expected, d, n, message.v );
+                decryptCrt( result, key, message.v );
+                if ( mpz_cmp( result, expected ) != 0 ) {
+                    std::cerr << "CRT decryption mismatch, " << bits << " bits, " << k << " primes" << std::endl;
+                    mpz_clears( n, e, d, wide, result, expected, nullptr );
+                    return false;
+                }
+            }
+            std::string suffix = k == 2 ? "" : "_k" + std::to_string( k );
+            if ( k == 2 ) {
+                run( options, "encrypt", bits, [&]( size_t i ) {
+                    encrypt( result, e, n, messages[i % POOL].v );
+                } );
+                do {
+                    randomNumber( wide, bits );
+                } while ( computeKeys( primes, wide, d ) != SUCCESS );
+                run( options, "encrypt_wide", bits, [&]( size_t i ) {
+                    encrypt( result, wide, n, messages[i % POOL].v );
+                } );
+                computeKeys( primes, e, d );
+                run( options, "decrypt", bits, [&]( size_t i ) {
+                    decrypt( result, d, n, messages[i % POOL].v );
+                } );
+            }
+            run( options, "decrypt_crt" + suffix, bits, [&]( size_t i ) {
+                decryptCrt( result, key, messages[i % POOL].v );
+            } );
+        }
+    }
+    mpz_clears( n, e, d, wide, result, expected, nullptr );
+    return true;
+}
+
+void benchFactor( const Options & options ) {
+    mpz_t n, e, d, p, q;
+    mpz_inits( n, e, d, p, q, nullptr );
+    for ( size_t bits : { 32, 40, 48, 56 } ) {
+        setRandomSeed( SEED );
+        MpzList moduli( POOL );
+        for ( Mpz & modulus : moduli ) {
+            MpzList primes;
+            makeKey( bits, 2, primes, modulus.v, e, d );
+        }
+        run( options, "primeFactorPollard", bits, [&]( size_t i ) {
+            primeFactorPollard( p, q, moduli[i % POOL].v );
+        } );
+    }
+    for ( size_t bits : { 32, 40, 48, 56, 64, 80 } ) {
+        setRandomSeed( SEED );
+        MpzList moduli( POOL );
+        for ( Mpz & modulus : moduli ) {
+            MpzList primes;
+            makeKey( bits, 2, primes, modulus.v, e, d );
+        }
+        run( options, "factorSmall", bits, [&]( size_t i ) {
+            factorSmall( p, q, moduli[i % POOL].v );
+        } );
+    }
+    if ( options.siqs ) {
+        for ( size_t digits : { 50, 60, 70, 80 } ) {
+            setRandomSeed( SEED );
+            semiprime( n, digits );
+            run( options, "factorSiqs", digits, [&]( size_t ) {
+                factorSiqs( p, q, n );
+            }, 1 );
+        }
+        // Above 310 bits the sieve threshold is scaled below 128, relations per operation
+        setRandomSeed( SEED );
+        semiprime( n, 95 );
+        run( options, "siqsRelations", 95, [&]( size_t ) {
+            siqsRelations( n, SIQS_CHECK_RELATIONS );
+        }, 1 );
+    }
+    mpz_clears( n, e, d, p, q, nullptr );
+}
+
+int main( int argc, const char ** argv ) {
+    Options options = { false, "", 200e6, false };
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg = argv[i];
+        if ( arg == "--csv" ) {
+            options.csv = true;
+        }
+        else if ( arg == "--filter" && i + 1 < argc ) {
+            options.filter = argv[++i];
+        }
+        else if ( arg == "--min-time" && i + 1 < argc ) {
+            options.minTime = std::atof( argv[++i] ) * 1e6;
+        }
+        else if ( arg == "--siqs" ) {
+            options.siqs = true;
+        }
+        else {
+            std::cerr << "Invalid arguments. Run as ./bench [ --csv ] [ --filter text ] [ --min-time ms ] [ --siqs ]" << std::endl;
+            return 1;
+        }
+    }
+
+    if ( options.csv ) {
+        std::cout << "name,param,iterations,ns_per_op" << std::endl;
+    }
+    benchArithmetic( options );
+    benchPrimes( options );
+    if ( !benchCipher( options ) ) {
+        return 1;
+    }
+    benchFactor( options );
+    return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/bash
+# Compares two CSV files produced by "./bench --csv" and flags benchmarks
+# that got slower than threshold percent, run as
+#   ./bench_compare.sh baseline.csv current.csv [ threshold ]
+# threshold defaults to 25, the BENCH_THRESHOLD of Makefile
+
+if [ $# -lt 2 ]; then
+	echo "Invalid arguments. Run as ./bench_compare.sh baseline.csv current.csv [ threshold ]" >&2
+	exit 1
+fi
+
+awk -F, -v threshold="${3:-25}" '
+	FNR == 1 { next }
+	NR == FNR { baseline[$1 "/" $2] = $4; next }
+	{
+		name = $1 "/" $2
+		if ( !( name in baseline ) ) {
+			printf "%-28s %14s %14.1f   new\n", name, "-", $4
+			next
+		}
+		change = ( $4 - baseline[name] ) * 100 / baseline[name]
+		status = "ok"
+		if ( change > threshold ) {
+			status = "REGRESSION"
+			failed++
+		}
+		else if ( change < -threshold ) {
+			status = "improved"
+		}
+		printf "%-28s %14.1f %14.1f %+7.1f%%  %s\n", name, baseline[name], $4, change, status
+	}
+	END {
+		if ( failed ) {
+			printf "%d benchmark(s) regressed by more than %s%%\n", failed, threshold
+			exit 1
+		}
+	}
+' "$1" "$2"
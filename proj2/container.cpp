@@ -0,0 +1,165 @@
+#include "container.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char   MAGIC[4]    = { 'K', 'R', 'Y', 'B' };
+static const int    VERSION     = 1;
+static const size_t BUFFER_SIZE = 1 << 20;
+
+static uint64_t readLittle( const unsigned char * data, size_t bytes ) {
+    uint64_t value = 0;
+    for ( size_t i = bytes; i-- > 0; ) {
+        value = ( value << 8 ) | data[i];
+    }
+    return value;
+}
+
+static void writeLittle( unsigned char * data, uint64_t value, size_t bytes ) {
+    for ( size_t i = 0; i < bytes; i++ ) {
+        data[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+ContainerReader::ContainerReader() : data_( nullptr ), length_( 0 ), kind_( CONTAINER_BATCH ), width_( 1 ) {}
+
+ContainerReader::~ContainerReader() {
+    close();
+}
+
+ReturnValues ContainerReader::open( const std::string & filename ) {
+    close();
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        return FILE_ACCESS_FAIL;
+    }
+
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 || static_cast<size_t>( info.st_size ) < CONTAINER_HEADER_SIZE ) {
+        ::close( fd );
+        return INVALID_FILE_FORMAT;
+    }
+
+    void * map = mmap( nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( map == MAP_FAILED ) {
+        return FILE_ACCESS_FAIL;
+    }
+    madvise( map, info.st_size, MADV_SEQUENTIAL );
+    data_   = static_cast<const unsigned char *>( map );
+    length_ = info.st_size;
+
+    uint64_t count = readLittle( data_ + 8, 8 );
+    kind_  = static_cast<ContainerKind>( data_[5] );
+    width_ = readLittle( data_ + 6, 2 );
+    if ( std::memcmp( data_, MAGIC, 4 ) != 0 || data_[4] != VERSION || width_ == 0 ||
+         ( kind_ != CONTAINER_KEY && kind_ != CONTAINER_BATCH ) || count % width_ != 0 ||
+         count > ( length_ - CONTAINER_HEADER_SIZE ) / 4 ) {
+        close();
+        return INVALID_FILE_FORMAT;
+    }
+
+    offsets_.reserve( count );
+    size_t offset = CONTAINER_HEADER_SIZE;
+    for ( uint64_t i = 0; i < count; i++ ) {
+        if ( length_ - offset < 4 ) {
+            close();
+            return INVALID_FILE_FORMAT;
+        }
+        size_t size = readLittle( data_ + offset, 4 );
+        if ( length_ - offset - 4 < size ) {
+            close();
+            return INVALID_FILE_FORMAT;
+        }
+        offsets_.push_back( offset );
+        offset += 4 + size;
+    }
+
+    return SUCCESS;
+}
+
+void ContainerReader::close() {
+    if ( data_ ) {
+        munmap( const_cast<unsigned char *>( data_ ), length_ );
+    }
+    data_   = nullptr;
+    length_ = 0;
+    offsets_.clear();
+}
+
+void ContainerReader::get( mpz_t & result, size_t i ) const {
+    const unsigned char * record = data_ + offsets_[i];
+    mpz_import( result, readLittle( record, 4 ), 1, 1, 1, 0, record + 4 );
+}
+
+ContainerWriter::ContainerWriter() : file_( nullptr ), count_( 0 ), used_( 0 ) {}
+
+ContainerWriter::~ContainerWriter() {
+    close();
+}
+
+ReturnValues ContainerWriter::open( const std::string & filename, ContainerKind kind, size_t width ) {
+    close();
+    file_ = std::fopen( filename.c_str(), "wb" );
+    if ( !file_ ) {
+        return FILE_ACCESS_FAIL;
+    }
+    count_ = 0;
+    buffer_.resize( BUFFER_SIZE );
+
+    std::memcpy( buffer_.data(), MAGIC, 4 );
+    buffer_[4] = VERSION;
+    buffer_[5] = kind;
+    writeLittle( buffer_.data() + 6, width, 2 );
+    writeLittle( buffer_.data() + 8, 0, 8 );
+    used_ = CONTAINER_HEADER_SIZE;
+    return SUCCESS;
+}
+
+ReturnValues ContainerWriter::append( const mpz_t & num ) {
+    size_t size = mpz_cmp_ui( num, 0 ) == 0 ? 0 : ( mpz_sizeinbase( num, 2 ) + 7 ) >> 3;
+    if ( buffer_.size() - used_ < size + 4 ) {
+        ReturnValues ret = flush();
+        if ( ret != SUCCESS ) {
+            return ret;
+        }
+        if ( buffer_.size() < size + 4 ) {
+            buffer_.resize( size + 4 );
+        }
+    }
+
+    size_t written = 0;
+    mpz_export( buffer_.data() + used_ + 4, &written, 1, 1, 1, 0, num );
+    writeLittle( buffer_.data() + used_, written, 4 );
+    used_ += 4 + written;
+    count_++;
+    return SUCCESS;
+}
+
+ReturnValues ContainerWriter::flush() {
+    if ( used_ && std::fwrite( buffer_.data(), 1, used_, file_ ) != used_ ) {
+        return FILE_ACCESS_FAIL;
+    }
+    used_ = 0;
+    return SUCCESS;
+}
+
+ReturnValues ContainerWriter::close() {
+    if ( !file_ ) {
+        return SUCCESS;
+    }
+    ReturnValues ret = flush();
+    unsigned char count[8];
+    writeLittle( count, count_, 8 );
+    if ( ret == SUCCESS && ( std::fseek( file_, 8, SEEK_SET ) != 0 || std::fwrite( count, 1, 8, file_ ) != 8 ) ) {
+        ret = FILE_ACCESS_FAIL;
+    }
+    if ( std::fclose( file_ ) != 0 && ret == SUCCESS ) {
+        ret = FILE_ACCESS_FAIL;
+    }
+    file_ = nullptr;
+    return ret;
+}
@@ -0,0 +1,77 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "kry.h"
+
+/*
+ * Length-prefixed binary container for keys and ciphertext batches.
+ *
+ * Layout, all header integers are little endian:
+ *   char[4]  magic "KRYB"
+ *   uint8    version
+ *   uint8    kind  (ContainerKind)
+ *   uint16   width (numbers per item, 5 for key "p q n e d", 1 for batch)
+ *   uint64   count (total number of records)
+ *   count times: uint32 length, length bytes of big endian magnitude
+ *
+ * Records are imported straight from the memory mapped file with mpz_import,
+ * no text is parsed and nothing is copied on the way.
+ */
+enum ContainerKind { CONTAINER_KEY = 1, CONTAINER_BATCH = 2 };
+
+const size_t CONTAINER_HEADER_SIZE = 16;
+
+class ContainerReader {
+public:
+    ContainerReader();
+    ~ContainerReader();
+
+    ReturnValues open( const std::string & filename );
+    void close();
+
+    ContainerKind kind()  const { return kind_; }
+    size_t        width() const { return width_; }
+    size_t        size()  const { return offsets_.size(); }
+
+    /*
+     * Imports i-th record into result
+     */
+    void get( mpz_t & result, size_t i ) const;
+
+private:
+    ContainerReader( const ContainerReader & );
+    ContainerReader & operator=( const ContainerReader & );
+
+    const unsigned char * data_;
+    size_t                length_;
+    ContainerKind         kind_;
+    size_t                width_;
+    std::vector<size_t>   offsets_;
+};
+
+class ContainerWriter {
+public:
+    ContainerWriter();
+    ~ContainerWriter();
+
+    ReturnValues open( const std::string & filename, ContainerKind kind, size_t width );
+    ReturnValues append( const mpz_t & num );
+    ReturnValues close();
+
+private:
+    ContainerWriter( const ContainerWriter & );
+    ContainerWriter & operator=( const ContainerWriter & );
+
+    ReturnValues flush();
+
+    FILE *                     file_;
+    uint64_t                   count_;
+    std::vector<unsigned char> buffer_;
+    size_t                     used_;
+};
+
+#endif
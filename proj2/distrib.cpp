@@ -0,0 +1,414 @@
+#include "distrib.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "stats.h"
+
+// Products of differences multiplied before one gcd
+static const uint64_t RHO_BATCH = 128;
+
+// Batches between two looks at the coordinator socket
+static const uint64_t STOP_CHECK = 64;
+
+// Coordinator wakes up this often to notice local workers that died
+static const int POLL_TIMEOUT_MS = 1000;
+
+struct Client {
+    int         fd;
+    std::string buffer;
+    uint64_t    unit;  // 0 when idle
+    RhoWalk     walk;  // as handed out with unit
+};
+
+static bool sendLine( int fd, const std::string & line ) {
+    std::string data = line + '\n';
+    for ( size_t sent = 0; sent < data.size(); ) {
+        ssize_t written = send( fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL );
+        if ( written < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( written <= 0 ) {
+            return false;
+        }
+        sent += written;
+    }
+    return true;
+}
+
+/*
+ * Moves first complete line from buffer to line
+ */
+static bool takeLine( std::string & buffer, std::string & line ) {
+    size_t end = buffer.find( '\n' );
+    if ( end == std::string::npos ) {
+        return false;
+    }
+    line = buffer.substr( 0, end );
+    buffer.erase( 0, end + 1 );
+    return true;
+}
+
+/*
+ * Appends whatever is waiting on fd to buffer, false on closed connection
+ */
+static bool receive( int fd, std::string & buffer ) {
+    char chunk[4096];
+    ssize_t length;
+    do {
+        length = recv( fd, chunk, sizeof( chunk ), 0 );
+    } while ( length < 0 && errno == EINTR );
+    if ( length <= 0 ) {
+        return false;
+    }
+    buffer.append( chunk, length );
+    return true;
+}
+
+static bool readLine( int fd, std::string & buffer, std::string & line ) {
+    while ( !takeLine( buffer, line ) ) {
+        if ( !receive( fd, buffer ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool stopRequested( int fd ) {
+    if ( fd < 0 ) {
+        return false;
+    }
+    pollfd entry = { fd, POLLIN, 0 };
+    return poll( &entry, 1, 0 ) > 0;
+}
+
+static bool socketAddress( sockaddr_un & address, const std::string & path ) {
+    std::memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    if ( path.size() >= sizeof( address.sun_path ) ) {
+        return false;
+    }
+    std::memcpy( address.sun_path, path.c_str(), path.size() + 1 );
+    return true;
+}
+
+static void rhoStep( mpz_t & y, unsigned long c, const mpz_t & n ) {
+    mpz_mul( y, y, y );
+    mpz_add_ui( y, y, c );
+    mpz_mod( y, y, n );
+}
+
+void startWalk( RhoWalk & walk, const mpz_t & n, unsigned long c, unsigned long x0 ) {
+    walk.c = c;
+    mpz_set_ui( walk.x.v, x0 );
+    mpz_mod( walk.x.v, walk.x.v, n );
+    mpz_set( walk.y.v, walk.x.v );
+    mpz_set_ui( walk.product.v, 1 );
+    walk.r    = 1;
+    walk.k    = 0;
+    walk.skip = 1;
+}
+
+/*
+ * "<c> <x> <y> <product> <r> <k> <skip>" of RhoWalk
+ */
+static std::string formatWalk( const RhoWalk & walk ) {
+    std::string line = std::to_string( walk.c );
+    for ( const Mpz * value : { &walk.x, &walk.y, &walk.product } ) {
+        char * str = mpz_get_str( nullptr, 16, value->v );
+        line += ' ';
+        line += str;
+        free( str );
+    }
+    return line + ' ' + std::to_string( walk.r ) + ' ' + std::to_string( walk.k ) + ' ' + std::to_string( walk.skip );
+}
+
+static bool parseWalk( std::istream & in, RhoWalk & walk ) {
+    std::string x, y, product;
+    return ( in >> walk.c >> x >> y >> product >> walk.r >> walk.k >> walk.skip ) && walk.r > 0 && walk.k < walk.r &&
+           walk.skip <= walk.r && ( walk.skip == 0 || walk.k == 0 ) &&
+           !mpz_set_str( walk.x.v, x.c_str(), 16 ) && !mpz_set_str( walk.y.v, y.c_str(), 16 ) &&
+           !mpz_set_str( walk.product.v, product.c_str(), 16 );
+}
+
+bool rhoUnit( mpz_t & factor, RhoWalk & walk, const mpz_t & n, uint64_t steps, int stopFd ) {
+    mpz_t ys, diff, g;
+    mpz_inits( ys, diff, g, nullptr );
+    mpz_set_ui( g, 1 );
+
+    uint64_t done    = 0;
+    uint64_t batches = 0;
+    while ( mpz_cmp_ui( g, 1 ) == 0 && done < steps ) {
+        // Skip runs in batches too, so it counts against steps and sees STOP
+        if ( walk.skip > 0 ) {
+            uint64_t batch = walk.skip < RHO_BATCH ? walk.skip : RHO_BATCH;
+            for ( uint64_t i = 0; i < batch; i++ ) {
+                rhoStep( walk.y.v, walk.c, n );
+            }
+            done      += batch;
+            walk.skip -= batch;
+            if ( ++batches % STOP_CHECK == 0 && stopRequested( stopFd ) ) {
+                break;
+            }
+            continue;
+        }
+        mpz_set( ys, walk.y.v );
+        uint64_t batch = walk.r - walk.k < RHO_BATCH ? walk.r - walk.k : RHO_BATCH;
+        for ( uint64_t i = 0; i < batch; i++ ) {
+            rhoStep( walk.y.v, walk.c, n );
+            mpz_sub( diff, walk.x.v, walk.y.v );
+            mpz_mul( walk.product.v, walk.product.v, diff );
+            mpz_mod( walk.product.v, walk.product.v, n );
+        }
+        done += batch;
+        mpz_gcd( g, walk.product.v, n );
+        walk.k += batch;
+        if ( walk.k == walk.r ) {
+            mpz_set( walk.x.v, walk.y.v );
+            walk.r   *= 2;
+            walk.k    = 0;
+            walk.skip = walk.r;
+        }
+        if ( ++batches % STOP_CHECK == 0 && stopRequested( stopFd ) ) {
+            break;
+        }
+    }
+
+    // The batch overshot, redo it one step at a time
+    if ( mpz_cmp( g, n ) == 0 ) {
+        mpz_set_ui( g, 1 );
+        for ( uint64_t i = 0; i < RHO_BATCH && mpz_cmp_ui( g, 1 ) == 0; i++ ) {
+            rhoStep( ys, walk.c, n );
+            mpz_sub( diff, walk.x.v, ys );
+            mpz_gcd( g, diff, n );
+        }
+        if ( mpz_cmp( g, n ) == 0 ) {
+            walk.r = 0;
+        }
+    }
+
+    bool found = mpz_cmp_ui( g, 1 ) > 0 && mpz_cmp( g, n ) < 0;
+    if ( found ) {
+        mpz_set( factor, g );
+    }
+    mpz_clears( ys, diff, g, nullptr );
+    return found;
+}
+
+ReturnValues runWorker( const std::string & socketPath ) {
+    sockaddr_un address;
+    if ( !socketAddress( address, socketPath ) ) {
+        return FILE_ACCESS_FAIL;
+    }
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 ) {
+        return FILE_ACCESS_FAIL;
+    }
+    if ( connect( fd, reinterpret_cast<sockaddr *>( &address ), sizeof( address ) ) != 0 ) {
+        close( fd );
+        return FILE_ACCESS_FAIL;
+    }
+
+    mpz_t n, factor;
+    mpz_inits( n, factor, nullptr );
+    RhoWalk walk;
+    std::string buffer, line;
+    ReturnValues ret = sendLine( fd, "READY" ) ? SUCCESS : FILE_ACCESS_FAIL;
+    while ( ret == SUCCESS && readLine( fd, buffer, line ) ) {
+        std::istringstream in( line );
+        std::string command, id, modulus;
+        uint64_t steps = 0;
+        in >> command;
+        if ( command == "STOP" ) {
+            break;
+        }
+        if ( command != "RHO" || !( in >> id >> modulus ) || mpz_set_str( n, modulus.c_str(), 16 ) || !parseWalk( in, walk ) ||
+             !( in >> steps ) ) {
+            ret = INVALID_FILE_FORMAT;
+            break;
+        }
+
+        std::string reply = "DONE " + id;
+        if ( rhoUnit( factor, walk, n, steps, fd ) ) {
+            char * factorStr = mpz_get_str( nullptr, 16, factor );
+            reply = "FOUND " + id + ' ' + factorStr;
+            free( factorStr );
+        }
+        else if ( walk.r > 0 ) {
+            reply += ' ' + formatWalk( walk );
+        }
+        if ( !sendLine( fd, reply ) ) {
+            break;
+        }
+    }
+    mpz_clears( n, factor, nullptr );
+    close( fd );
+    return ret;
+}
+
+/*
+ * Reaps finished local workers, returns number of those still running
+ */
+static size_t reapWorkers( std::vector<pid_t> & children, bool wait ) {
+    for ( auto it = children.begin(); it != children.end(); ) {
+        if ( waitpid( *it, nullptr, wait ? 0 : WNOHANG ) != 0 ) {
+            it = children.erase( it );
+        }
+        else {
+            it++;
+        }
+    }
+    return children.size();
+}
+
+ReturnValues factorDistributed( mpz_t & p, mpz_t & q, const mpz_t & n, size_t workers, const std::string & socketPath ) {
+    if ( mpz_cmp_ui( n, 4 ) < 0 || isPrime( n, mpz_sizeinbase( n, 2 ) ) ) {
+        return INVALID_PARAM_N;
+    }
+    if ( mpz_even_p( n ) ) {
+        mpz_set_ui( p, 2 );
+        mpz_divexact_ui( q, n, 2 );
+        return SUCCESS;
+    }
+    if ( mpz_perfect_square_p( n ) ) {
+        mpz_sqrt( p, n );
+        mpz_set( q, p );
+        return SUCCESS;
+    }
+
+    std::string path = socketPath.empty() ? "/tmp/kry-" + std::to_string( getpid() ) + ".sock" : socketPath;
+    sockaddr_un address;
+    if ( !socketAddress( address, path ) ) {
+        return FILE_ACCESS_FAIL;
+    }
+    int listenFd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( listenFd < 0 ) {
+        return FILE_ACCESS_FAIL;
+    }
+    unlink( path.c_str() );
+    if ( bind( listenFd, reinterpret_cast<sockaddr *>( &address ), sizeof( address ) ) != 0 || listen( listenFd, SOMAXCONN ) != 0 ) {
+        close( listenFd );
+        return FILE_ACCESS_FAIL;
+    }
+
+    std::vector<pid_t> children;
+    for ( size_t i = 0; i < workers; i++ ) {
+        pid_t pid = fork();
+        if ( pid == 0 ) {
+            close( listenFd );
+            _exit( runWorker( path ) == SUCCESS ? 0 : 1 );
+        }
+        if ( pid > 0 ) {
+            children.push_back( pid );
+        }
+    }
+
+    char * modulusStr = mpz_get_str( nullptr, 16, n );
+    std::string modulus = modulusStr;
+    free( modulusStr );
+
+    mpz_t factor;
+    mpz_init( factor );
+    std::vector<Client> clients;
+    std::deque<RhoWalk> paused;  // walks between units, resumed by next free worker
+    uint64_t      nextUnit = 1;
+    unsigned long nextWalk = 1;
+    bool found = false;
+    while ( !found ) {
+        std::vector<pollfd> entries( 1, pollfd{ listenFd, POLLIN, 0 } );
+        for ( const Client & client : clients ) {
+            entries.push_back( pollfd{ client.fd, POLLIN, 0 } );
+        }
+        if ( poll( entries.data(), entries.size(), POLL_TIMEOUT_MS ) < 0 && errno != EINTR ) {
+            break;
+        }
+
+        std::vector<Client> alive;
+        for ( size_t i = 0; i < clients.size(); i++ ) {
+            Client & client = clients[i];
+            bool open = !( entries[i + 1].revents & ( POLLIN | POLLHUP | POLLERR ) ) || receive( client.fd, client.buffer );
+            std::string line;
+            while ( open && !found && takeLine( client.buffer, line ) ) {
+                std::istringstream in( line );
+                std::string command, id, value;
+                in >> command >> id;
+                if ( command != "READY" && id != std::to_string( client.unit ) ) {
+                    open = false;
+                    break;
+                }
+                if ( command == "FOUND" && ( in >> value ) && !mpz_set_str( factor, value.c_str(), 16 ) &&
+                     mpz_cmp_ui( factor, 1 ) > 0 && mpz_cmp( factor, n ) < 0 && mpz_divisible_p( n, factor ) ) {
+                    found = true;
+                    break;
+                }
+                if ( command == "DONE" ) {
+                    // Walk goes on where the unit stopped, one that closed its cycle comes back empty
+                    RhoWalk walk;
+                    if ( parseWalk( in, walk ) && walk.c == client.walk.c ) {
+                        paused.push_back( walk );
+                    }
+                }
+                else if ( command != "READY" && command != "FOUND" ) {
+                    open = false;
+                    break;
+                }
+
+                if ( paused.empty() ) {
+                    startWalk( client.walk, n, nextWalk++, 2 );
+                }
+                else {
+                    client.walk = paused.front();
+                    paused.pop_front();
+                }
+                client.unit = nextUnit++;
+                STAT_INC( STAT_DIST_UNITS );
+                open = sendLine( client.fd, "RHO " + std::to_string( client.unit ) + ' ' + modulus + ' ' + formatWalk( client.walk ) + ' ' +
+                                            std::to_string( DIST_UNIT_STEPS ) );
+            }
+            if ( open ) {
+                alive.push_back( client );
+            }
+            else {
+                // Unit of a lost worker is rerun from the state it was handed out with
+                if ( client.unit ) {
+                    paused.push_back( client.walk );
+                }
+                close( client.fd );
+            }
+        }
+        clients.swap( alive );
+
+        if ( entries[0].revents & POLLIN ) {
+            int fd = accept( listenFd, nullptr, nullptr );
+            if ( fd >= 0 ) {
+                STAT_INC( STAT_DIST_WORKERS );
+                clients.push_back( Client{ fd, std::string(), 0, RhoWalk() } );
+            }
+        }
+        if ( workers > 0 && clients.empty() && reapWorkers( children, false ) == 0 ) {
+            break;
+        }
+    }
+
+    for ( const Client & client : clients ) {
+        sendLine( client.fd, "STOP" );
+        close( client.fd );
+    }
+    close( listenFd );
+    unlink( path.c_str() );
+    reapWorkers( children, true );
+
+    if ( found ) {
+        mpz_set( p, factor );
+        mpz_divexact( q, n, factor );
+    }
+    mpz_clear( factor );
+    return found ? SUCCESS : INVALID_PARAM_N;
+}
@@ -0,0 +1,69 @@
+#ifndef DISTRIB_H
+#define DISTRIB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <gmp.h>
+#include "kry.h"
+
+/*
+ * Distributed factoring over a local (AF_UNIX) socket.
+ *
+ * The coordinator splits the job into self-contained work units and hands them
+ * to whichever worker asks next. Every message is one text line:
+ *
+ *   worker      -> coordinator   READY
+ *   coordinator -> worker        RHO <id> <n hex> <walk> <steps>
+ *   worker      -> coordinator   DONE <id> [ <walk> ] | FOUND <id> <factor hex>
+ *   coordinator -> worker        STOP
+ *
+ * where <walk> is "<c> <x hex> <y hex> <product hex> <r> <k> <skip>", see RhoWalk.
+ * A RHO unit continues Brent walk x -> x^2 + c mod n for about steps
+ * iterations and DONE hands the walk back, the coordinator gives it to the
+ * next free worker. Walks are never restarted, a worker that goes away loses
+ * only its current unit. Unit lines carry the whole state, so one saved to a
+ * file can be rerun anywhere. Workers look for STOP between gcd batches, the
+ * whole pool stops within milliseconds of the first factor.
+ */
+const uint64_t DIST_UNIT_STEPS = 1 << 22;
+
+/*
+ * Brent walk between units. y is the current point, x the point saved when
+ * power of two r started, skip the steps of its first r steps still ahead, k the
+ * steps of the following r already compared with x and product the running
+ * product of differences.
+ * r = 0 marks walk that closed its cycle without splitting n, DONE then
+ * carries no walk and the coordinator starts a new one
+ */
+struct RhoWalk {
+    unsigned long c;
+    Mpz           x, y, product;
+    uint64_t      r, k, skip;
+};
+
+/*
+ * Sets walk with constant c to its start at x0
+ */
+void startWalk( RhoWalk & walk, const mpz_t & n, unsigned long c, unsigned long x0 );
+
+/*
+ * Runs coordinator on socketPath and forks workers local worker processes, more
+ * workers can join with "kry -w socketPath". Empty socketPath picks one in /tmp.
+ * Returns INVALID_PARAM_N for prime n or when every worker went away
+ */
+ReturnValues factorDistributed( mpz_t & p, mpz_t & q, const mpz_t & n, size_t workers, const std::string & socketPath );
+
+/*
+ * Connects to coordinator and processes units until STOP
+ */
+ReturnValues runWorker( const std::string & socketPath );
+
+/*
+ * Runs one RHO unit, advances walk by at least steps iterations and stops at
+ * the end of a gcd batch, returns true and nontrivial factor when the walk found
+ * one. stopFd >= 0 is polled between batches, any input on it aborts the walk
+ */
+bool rhoUnit( mpz_t & factor, RhoWalk & walk, const mpz_t & n, uint64_t steps, int stopFd = -1 );
+
+#endif
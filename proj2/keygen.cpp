@@ -0,0 +1,405 @@
+#include "keygen.h"
+#include <algorithm>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "container.h"
+#include "stats.h"
+
+// Sieved window holds SIEVE_SPAN * bits odd numbers, about 11 primes on average
+static const size_t SIEVE_SPAN = 4;
+
+// Small primes used by the sieve stage
+static const unsigned SIEVE_LIMIT = 1 << 16;
+
+// Capacity of queues between stages, windows sieved ahead are thrown away at the end
+static const size_t QUEUE_CAPACITY = 64;
+
+// Smallest supported prime size, windows of smaller ones hardly stay in range
+static const size_t MIN_PRIME_BITS = 16;
+
+/*
+ * Random odd base and offsets that survived the sieve, base + 2 * offset
+ * stays within slot size
+ */
+struct Window {
+    Mpz                   base;
+    std::vector<uint32_t> offsets;
+    size_t                slot;  // index of prime within key, slots differ in bit size
+};
+
+struct Candidate {
+    Mpz    value;
+    size_t slot;
+};
+
+/*
+ * Blocking queue with fixed capacity, close() wakes every waiting thread
+ */
+template<class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue( size_t capacity ) : capacity_( capacity ), closed_( false ) {}
+
+    bool push( const T & item ) {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        notFull_.wait( lock, [this] { return closed_ || items_.size() < capacity_; } );
+        if ( closed_ ) {
+            return false;
+        }
+        items_.push_back( item );
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    bool pop( T & item ) {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        notEmpty_.wait( lock, [this] { return closed_ || !items_.empty(); } );
+        if ( closed_ ) {
+            return false;
+        }
+        item = items_.front();
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+private:
+    size_t                  capacity_;
+    bool                    closed_;
+    std::deque<T>           items_;
+    std::mutex              mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+};
+
+static std::vector<unsigned> sievePrimes() {
+    std::vector<bool> composite( SIEVE_LIMIT, false );
+    std::vector<unsigned> primes;
+    for ( unsigned i = 3; i < SIEVE_LIMIT; i += 2 ) {
+        if ( !composite[i] ) {
+            primes.push_back( i );
+            for ( unsigned j = i * i; j < SIEVE_LIMIT; j += 2 * i ) {
+                composite[j] = true;
+            }
+        }
+    }
+    return primes;
+}
+
+/*
+ * Sieve stage, pushes sieved windows at random bases for every slot in turn.
+ * Closes the pipeline when random source fails
+ */
+static void sieveStage( BoundedQueue<Window> & windows, BoundedQueue<Candidate> & primes, const std::vector<size_t> & sizes ) {
+    std::vector<unsigned> small = sievePrimes();
+    std::vector<bool> composite;
+    Window window;
+    mpz_t top;
+    mpz_init( top );
+    for ( size_t round = 0; ; round++ ) {
+        window.slot = round % sizes.size();
+        size_t size = sizes[window.slot];
+        if ( randomNumber( window.base.v, size, true ) != SUCCESS ) {
+            windows.close();
+            primes.close();
+            break;
+        }
+
+        // Base is at least 2^(size - 1), so primes below that never strike themselves
+        size_t span = SIEVE_SPAN * size;
+        composite.assign( span, false );
+        for ( unsigned p : small ) {
+            if ( size <= 32 && p >= ( 1ul << ( size - 1 ) ) ) {
+                break;
+            }
+            unsigned long r = mpz_fdiv_ui( window.base.v, p );
+            for ( size_t i = ( p - r ) % p * ( ( p + 1 ) / 2 ) % p; i < span; i += p ) {
+                composite[i] = true;
+            }
+        }
+
+        // Offsets past 2^size - 1 are cut off
+        mpz_set_ui( top, 0 );
+        mpz_setbit( top, size );
+        mpz_sub( top, top, window.base.v );
+        mpz_fdiv_q_2exp( top, top, 1 );
+        if ( mpz_sgn( top ) <= 0 ) {
+            continue;
+        }
+        if ( mpz_cmp_ui( top, span ) < 0 ) {
+            span = mpz_get_ui( top );
+        }
+
+        window.offsets.clear();
+        for ( size_t i = 0; i < span; i++ ) {
+            if ( composite[i] ) {
+                STAT_INC( STAT_KEYGEN_SIEVED );
+            }
+            else {
+                window.offsets.push_back( i );
+            }
+        }
+        if ( !windows.push( window ) ) {
+            break;
+        }
+    }
+    mpz_clear( top );
+}
+
+/*
+ * Testing stage, forwards the first prime of every window that keeps e invertible
+ */
+static void testStage( BoundedQueue<Window> & windows, BoundedQueue<Candidate> & primes, const mpz_t & e, const std::vector<size_t> & sizes ) {
+    Window window;
+    Candidate candidate;
+    while ( windows.pop( window ) ) {
+        bool found = false;
+        candidate.slot = window.slot;
+        for ( size_t i = 0; i < window.offsets.size() && !found; i++ ) {
+            mpz_add_ui( candidate.value.v, window.base.v, 2 * window.offsets[i] );
+            STAT_INC( STAT_PRIME_CANDIDATES );
+            if ( !fitsExponent( candidate.value.v, e ) ) {
+                STAT_INC( STAT_PRIME_REJECTED_EXPONENT );
+                continue;
+            }
+            found = isPrime( candidate.value.v, sizes[window.slot] );
+            if ( !found ) {
+                STAT_INC( STAT_PRIME_REJECTED_TEST );
+            }
+        }
+        if ( found && !primes.push( candidate ) ) {
+            break;
+        }
+    }
+}
+
+/*
+ * Sieve and testing stages running on their own threads, primes come out of next()
+ */
+class PrimePipeline {
+public:
+    PrimePipeline( const std::vector<size_t> & sizes, const mpz_t & e, size_t threads )
+        : sizes_( sizes ), windows_( QUEUE_CAPACITY ), primes_( QUEUE_CAPACITY ) {
+        mpz_set( e_.v, e );
+        if ( threads == 0 ) {
+            threads = std::max( 1u, std::thread::hardware_concurrency() );
+        }
+        stages_.emplace_back( sieveStage, std::ref( windows_ ), std::ref( primes_ ), std::cref( sizes_ ) );
+        for ( size_t i = 0; i < threads; i++ ) {
+            stages_.emplace_back( testStage, std::ref( windows_ ), std::ref( primes_ ), std::cref( e_.v ), std::cref( sizes_ ) );
+        }
+    }
+
+    ~PrimePipeline() {
+        windows_.close();
+        primes_.close();
+        for ( std::thread & stage : stages_ ) {
+            stage.join();
+        }
+    }
+
+    /*
+     * Waits for next prime, false when random source failed
+     */
+    bool next( Candidate & prime ) {
+        return primes_.pop( prime );
+    }
+
+private:
+    PrimePipeline( const PrimePipeline & );
+    PrimePipeline & operator=( const PrimePipeline & );
+
+    std::vector<size_t>      sizes_;
+    Mpz                      e_;
+    BoundedQueue<Window>     windows_;
+    BoundedQueue<Candidate>  primes_;
+    std::vector<std::thread> stages_;
+};
+
+/*
+ * Computes private exponents of whole batch with one inversion.
+ *
+ * d = e^-1 mod lambda equals ( 1 + t * lambda ) / e for t = -lambda^-1 mod e,
+ * so every key needs an inverse modulo the same e. Prefix products of lambdas
+ * are inverted once and unwound back to single inverses (Montgomery's trick).
+ */
+static void assembleBatch( std::vector<MpzList> & keys, const mpz_t & e ) {
+    size_t k = keys.front().size() - 3;
+    MpzList lambdas( keys.size() ), prefix( keys.size() );
+    mpz_t p1, inverse, single;
+    mpz_inits( p1, inverse, single, nullptr );
+    for ( size_t i = 0; i < keys.size(); i++ ) {
+        mpz_set_ui( lambdas[i].v, 1 );
+        for ( size_t j = 0; j < k; j++ ) {
+            mpz_sub_ui( p1, keys[i][j].v, 1 );
+            mpz_lcm( lambdas[i].v, lambdas[i].v, p1 );
+        }
+        mpz_mod( p1, lambdas[i].v, e );
+        if ( i == 0 ) {
+            mpz_set( prefix[i].v, p1 );
+        }
+        else {
+            mpz_mul( prefix[i].v, prefix[i - 1].v, p1 );
+            mpz_mod( prefix[i].v, prefix[i].v, e );
+        }
+    }
+
+    invert( inverse, prefix.back().v, e );
+    for ( size_t i = keys.size(); i-- > 0; ) {
+        if ( i > 0 ) {
+            mpz_mul( single, inverse, prefix[i - 1].v );
+            mpz_mod( single, single, e );
+            mpz_mul( inverse, inverse, lambdas[i].v );
+            mpz_mod( inverse, inverse, e );
+        }
+        else {
+            mpz_set( single, inverse );
+        }
+        mpz_t & d = keys[i][k + 2].v;
+        mpz_sub( single, e, single );
+        mpz_mod( single, single, e );
+        mpz_mul( d, single, lambdas[i].v );
+        mpz_add_ui( d, d, 1 );
+        mpz_divexact( d, d, e );
+    }
+    mpz_clears( p1, inverse, single, nullptr );
+}
+
+/*
+ * Writes assembled keys in hexadecimal text or to container
+ */
+static ReturnValues writeBatch( const std::vector<MpzList> & keys, FILE * text, ContainerWriter & writer ) {
+    ReturnValues ret = SUCCESS;
+    std::vector<char> digits;
+    std::string out;
+    for ( const MpzList & key : keys ) {
+        for ( size_t i = 0; i < key.size() && ret == SUCCESS; i++ ) {
+            if ( !text ) {
+                ret = writer.append( key[i].v );
+                continue;
+            }
+            digits.resize( mpz_sizeinbase( key[i].v, 16 ) + 2 );
+            mpz_get_str( digits.data(), 16, key[i].v );
+            out += "0x";
+            out += digits.data();
+            out += i + 1 < key.size() ? ' ' : '\n';
+        }
+    }
+    if ( text && std::fwrite( out.data(), 1, out.size(), text ) != out.size() ) {
+        ret = FILE_ACCESS_FAIL;
+    }
+    return ret;
+}
+
+ReturnValues generateKeys( size_t b, size_t k, size_t count, const mpz_t & e, const std::string & output, bool binary, size_t threads ) {
+    STAT_TIME( TIMER_GENERATE );
+    if ( k < 2 || b / k < MIN_PRIME_BITS ) {
+        return INVALID_ARGUMENTS;
+    }
+    if ( mpz_cmp_ui( e, 3 ) < 0 || mpz_even_p( e ) ) {
+        return INVALID_PARAM_E;
+    }
+    FILE * text = nullptr;
+    ContainerWriter writer;
+    if ( binary ) {
+        ReturnValues opened = writer.open( output, CONTAINER_KEY, k + 3 );
+        if ( opened != SUCCESS ) {
+            return opened;
+        }
+    }
+    else if ( !( text = output == "-" ? stdout : std::fopen( output.c_str(), "wb" ) ) ) {
+        return FILE_ACCESS_FAIL;
+    }
+
+    std::vector<size_t> sizes( k );
+    for ( size_t i = 0; i < k; i++ ) {
+        sizes[i] = b / k + ( i < b % k ? 1 : 0 );
+    }
+
+    PrimePipeline pipeline( sizes, e, threads );
+
+    // Primes waiting for the rest of their key, one pool per slot
+    std::vector<MpzList> pools( k );
+    std::vector<MpzList> batch;
+    ReturnValues ret = SUCCESS;
+    Candidate prime;
+    size_t written = 0;
+    while ( written < count && ret == SUCCESS && pipeline.next( prime ) ) {
+        pools[prime.slot].push_back( prime.value );
+        bool ready = true;
+        for ( const MpzList & pool : pools ) {
+            ready = ready && !pool.empty();
+        }
+        if ( !ready ) {
+            continue;
+        }
+
+        MpzList key( k + 3 );
+        for ( size_t i = 0; i < k; i++ ) {
+            key[i] = pools[i].back();
+            pools[i].pop_back();
+        }
+        std::sort( key.begin(), key.begin() + k, []( const Mpz & x, const Mpz & y ) { return mpz_cmp( x.v, y.v ) < 0; } );
+        bool distinct = true;
+        mpz_set_ui( key[k].v, 1 );
+        for ( size_t i = 0; i < k; i++ ) {
+            distinct = distinct && ( i == 0 || mpz_cmp( key[i - 1].v, key[i].v ) != 0 );
+            mpz_mul( key[k].v, key[k].v, key[i].v );
+        }
+        if ( !distinct ) {
+            STAT_INC( STAT_PRIME_REJECTED_DUPLICATE );
+            continue;
+        }
+        mpz_set( key[k + 1].v, e );
+        batch.push_back( key );
+
+        if ( batch.size() == KEYGEN_BATCH || written + batch.size() == count ) {
+            assembleBatch( batch, e );
+            ret = writeBatch( batch, text, writer );
+            written += batch.size();
+            batch.clear();
+        }
+    }
+
+    if ( ret == SUCCESS && written < count ) {
+        ret = FILE_ACCESS_FAIL;
+    }
+
+    ReturnValues closed = SUCCESS;
+    if ( binary ) {
+        closed = writer.close();
+    }
+    else if ( text != stdout && std::fclose( text ) != 0 ) {
+        closed = FILE_ACCESS_FAIL;
+    }
+    return ret == SUCCESS ? closed : ret;
+}
+
+ReturnValues generatePrimes( size_t b, const mpz_t & e, const std::function<bool( const mpz_t & )> & sink, size_t threads ) {
+    if ( b < MIN_PRIME_BITS ) {
+        return INVALID_ARGUMENTS;
+    }
+    if ( mpz_cmp_ui( e, 3 ) < 0 || mpz_even_p( e ) ) {
+        return INVALID_PARAM_E;
+    }
+    PrimePipeline pipeline( std::vector<size_t>( 1, b ), e, threads );
+    Candidate prime;
+    while ( pipeline.next( prime ) ) {
+        if ( !sink( prime.value.v ) ) {
+            return SUCCESS;
+        }
+    }
+    return FILE_ACCESS_FAIL;
+}
@@ -0,0 +1,35 @@
+#ifndef KEYGEN_H
+#define KEYGEN_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <gmp.h>
+#include "kry.h"
+
+/*
+ * Mass key generation, "kry -g BITS -n COUNT OUTPUT [bin]".
+ *
+ * Keys flow through a pipeline of three stages connected by bounded queues:
+ * one thread sieves windows of odd numbers at random bases by small primes,
+ * testing threads take the first prime of each window and the calling thread
+ * pairs primes into keys.
+ * Private exponents are computed per batch with a single inversion modulo e
+ * (Montgomery's trick), see assembleBatch in keygen.cpp.
+ */
+const size_t KEYGEN_BATCH = 256;
+
+/*
+ * Writes count keys made of k primes with public exponent e to output, one
+ * "p_1 ... p_k n e d" line per key, or key container when binary is set.
+ * threads = 0 uses every CPU for primality testing
+ */
+ReturnValues generateKeys( size_t b, size_t k, size_t count, const mpz_t & e, const std::string & output, bool binary, size_t threads = 0 );
+
+/*
+ * Runs sieve and testing stages alone, hands primes of b bits that keep e
+ * invertible to sink until it returns false
+ */
+ReturnValues generatePrimes( size_t b, const mpz_t & e, const std::function<bool( const mpz_t & )> & sink, size_t threads = 0 );
+
+#endif
@@ -4,15 +4,28 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
 #include <gmp.h>
+#include "kry.h"
+#include "container.h"
+#include "distrib.h"
+#include "keygen.h"
+#include "primepool.h"
+#include "siqs.h"
+#include "smallmod.h"
+#include "stats.h"
 #define debug(str,n) std::cerr << __LINE__ << ": " << str << ": " << mpz_get_str( nullptr, FORMAT, n ) << std::endl
 #define print(str) std::cerr << str << std::endl
 
-enum Settings     { GENERATE, DECRYPT, ENCRYPT, BREAK, INVALID };
-enum ReturnValues { SUCCESS = 0, INVALID_ARGUMENTS, MPZ_INIT_FAIL, FILE_ACCESS_FAIL, INVALID_PARAM_E, INVALID_PARAM_N };
+enum Settings     { GENERATE, DECRYPT, ENCRYPT, BREAK, HEX2BIN, BIN2HEX, ENCRYPT_BATCH, DECRYPT_BATCH, WORKER, GENERATE_MANY, POOL, INVALID };
 const int FORMAT    = 16;
 const char * PREFIX = FORMAT == 16 ? "0x" : "";
 
+// Duplicate primes drawn before a size too small for the key grows
+const size_t DUPLICATE_RETRIES = 64;
+
 bool isUnsigned( const std::string & str ) {
     for ( char c : str ) {
         if ( !std::isdigit( c ) ) {
@@ -50,14 +63,53 @@ Settings parseArguments( int argc, const char ** argv ) {
         return INVALID;
     }
     else if ( argc == 3) {
+        if ( std::string( argv[1] ) == "-X" ) {
+            return BIN2HEX;
+        }
+        if ( std::string( argv[1] ) == "-w" ) {
+            return WORKER;
+        }
         if ( std::string( argv[1] ) != "-g" || !isUnsigned( argv[2] ) ) {
             return INVALID;
         }
         return GENERATE;
     }
+    else if ( ( argc == 4 || argc == 5 ) && std::string( argv[1] ) == "-P" ) {
+        std::string action = argv[2];
+        bool count = argc == 4 || ( action != "info" && isUnsigned( argv[4] ) );
+        return ( action == "fill" || action == "keep" || action == "info" ) && isUnsigned( argv[3] ) && count ? POOL : INVALID;
+    }
+    else if ( argc == 4 && std::string( argv[1] ) == "-g" ) {
+        return isUnsigned( argv[2] ) && isUnsigned( argv[3] ) ? GENERATE : INVALID;
+    }
+    else if ( argc == 5 && std::string( argv[1] ) == "-g" ) {
+        return isUnsigned( argv[2] ) && isUnsigned( argv[3] ) && isHexaDecimal( argv[4] ) ? GENERATE : INVALID;
+    }
+    else if ( ( argc == 6 || argc == 7 ) && std::string( argv[1] ) == "-g" && std::string( argv[3] ) == "-n" ) {
+        bool format = argc == 6 || std::string( argv[6] ) == "bin";
+        return isUnsigned( argv[2] ) && isUnsigned( argv[4] ) && format ? GENERATE_MANY : INVALID;
+    }
+    else if ( argc > 5 && std::string( argv[1] ) == "-d" ) {
+        for ( int i = 2; i < argc; i++ ) {
+            if ( !isHexaDecimal( argv[i] ) ) {
+                return INVALID;
+            }
+        }
+        return DECRYPT;
+    }
     else if ( argc == 5 ) {
         std::string arg = argv[1];
-        if ( !isHexaDecimal( argv[2] ) || !isHexaDecimal( argv[3] ) || !isHexaDecimal( argv[4] ) ) {
+        if ( arg == "-x" ) {
+            std::string kind = argv[2];
+            return kind == "key" || kind == "batch" ? HEX2BIN : INVALID;
+        }
+        else if ( arg == "-E" ) {
+            return ENCRYPT_BATCH;
+        }
+        else if ( arg == "-D" ) {
+            return DECRYPT_BATCH;
+        }
+        else if ( !isHexaDecimal( argv[2] ) || !isHexaDecimal( argv[3] ) || !isHexaDecimal( argv[4] ) ) {
             return INVALID;
         }
         else if ( arg == "-e" ) {
@@ -74,20 +126,46 @@ Settings parseArguments( int argc, const char ** argv ) {
     return INVALID;
 }
 
-ReturnValues randomNumber( mpz_t & result, size_t bits, bool mask = false ) {
+static gmp_randstate_t seededState;
+static bool            seeded = false;
+static std::mutex      seededMutex;
+
+/*
+ * Replaces /dev/urandom with deterministic generator, used for repeatable benchmarks
+ */
+void setRandomSeed( unsigned long seed ) {
+    if ( !seeded ) {
+        gmp_randinit_default( seededState );
+        seeded = true;
+    }
+    gmp_randseed_ui( seededState, seed );
+}
+
+ReturnValues randomNumber( mpz_t & result, size_t bits, bool mask ) {
     size_t extra = bits % 8;
     size_t size  = ( ( bits + 8 - ( extra > 0 ? extra : 8 ) ) ) >> 3;
     std::vector<char> bytes( size );
     
-    std::ifstream randomSrc( "/dev/urandom", std::ios::out | std::ios::binary );
-    if ( !randomSrc.is_open() || !randomSrc.read( bytes.data(), size ) ) {
-        return FILE_ACCESS_FAIL;
+    if ( seeded ) {
+        std::lock_guard<std::mutex> lock( seededMutex );
+        for ( char & byte : bytes ) {
+            byte = gmp_urandomb_ui( seededState, 8 );
+        }
+    }
+    else {
+        std::ifstream randomSrc( "/dev/urandom", std::ios::out | std::ios::binary );
+        if ( !randomSrc.is_open() || !randomSrc.read( bytes.data(), size ) ) {
+            return FILE_ACCESS_FAIL;
+        }
+        randomSrc.close();
     }
-    randomSrc.close();
+    STAT_ADD( STAT_RANDOM_BYTES, size );
     
+    // Leading byte keeps bits % 8 bits, or all eight, with the highest of them set
     if ( mask ) {
-        bytes[0] &= 0b11111111 >> extra;
-        bytes[0] |= 0b10000000 >> extra; 
+        size_t top = extra > 0 ? extra : 8;
+        bytes[0] &= 0b11111111 >> ( 8 - top );
+        bytes[0] |= 1 << ( top - 1 );
         bytes[ bytes.size() - 1 ] |= 1;
     }
     
@@ -133,9 +211,12 @@ void invert( mpz_t & result, const mpz_t & num, const mpz_t & modulo ) {
     mpz_clears( mod, a, y, q, tmp, nullptr );
 } 
 
-void gcd( mpz_t & result, const mpz_t & a, const mpz_t & b ) {
-    if ( mpz_cmp( a, b ) < 0 ) {
-        gcd( result, b, a );
+static void gcdStep( mpz_t & result, const mpz_t & a, const mpz_t & b ) {
+    if ( mpz_cmp_ui( b, 0 ) == 0 ) {
+        mpz_set( result, a );
+    }
+    else if ( mpz_cmp( a, b ) < 0 ) {
+        gcdStep( result, b, a );
     }
     else {
         mpz_t mod;
@@ -145,16 +226,27 @@ void gcd( mpz_t & result, const mpz_t & a, const mpz_t & b ) {
             mpz_set( result, b );
         }
         else {
-            gcd( result, b, mod );
+            gcdStep( result, b, mod );
         }
         mpz_clear( mod );
     }
 }
 
+void gcd( mpz_t & result, const mpz_t & a, const mpz_t & b ) {
+    STAT_INC( STAT_GCD_CALLS );
+    gcdStep( result, a, b );
+}
+
 /*
  * Computes 
  */
 void powm( mpz_t & result, const mpz_t & num, const mpz_t & exp, const mpz_t & modulo ) {
+    STAT_INC( STAT_MODEXP_CALLS );
+    STAT_ADD( STAT_MODEXP_BITS, mpz_sizeinbase( exp, 2 ) );
+    if ( smallModulus( modulo ) && mpz_sgn( exp ) >= 0 ) {
+        powmSmall( result, num, exp, modulo );
+        return;
+    }
     mpz_t n;
     mpz_init( n );
     mpz_mod( n, num, modulo );
@@ -198,7 +290,10 @@ bool powerTest( const mpz_t & num, const mpz_t & exp, const mpz_t & modulo ) {
 /*
  * Tests if number is prime
  */
-bool isPrime( const mpz_t & n, size_t primeSize, size_t iterations = 30 ) {
+bool isPrime( const mpz_t & n, size_t primeSize, size_t iterations ) {
+    if ( fitsSmall( n ) ) {
+        return isPrimeSmall( n );
+    }
     if ( mpz_cmp_ui( n, 1 ) == 0 ) {
         return false;
     }
@@ -267,6 +362,7 @@ ReturnValues primeFactorPollard( mpz_t & p, mpz_t & q, const mpz_t & n ) {
             mpz_set_ui( d, 1 );
             set = true;
             while( mpz_cmp_ui( d, 1 ) == 0 ) {
+                STAT_INC( STAT_POLLARD_ITERATIONS );
                 mpz_set( x2, x );
                 powm( x, x2, num2, n );
                 mpz_add( x, x, c );
@@ -293,6 +389,7 @@ ReturnValues primeFactorPollard( mpz_t & p, mpz_t & q, const mpz_t & n ) {
                 }
                 
                 if ( mpz_cmp( d, n ) == 0 ) {
+                    STAT_INC( STAT_POLLARD_RESTARTS );
                     set = false;
                     break;
                 }
@@ -356,76 +453,176 @@ void primeFactor( mpz_t & p, mpz_t & q, const mpz_t & n ) {
 }
 
 /*
- * Computes public and private key from p and q
+ * Computes private key for public exponent e from primes, d is taken modulo lcm( p_i - 1 )
  */
-ReturnValues computeKeys( const mpz_t & p, const mpz_t & q, mpz_t & e, mpz_t & d, bool skip_e = false ) {
-    mpz_t p1, q1, phi, g, mul, mod;
-    mpz_inits( p1, q1, phi, g, mul, mod, nullptr );
+ReturnValues computeKeys( const MpzList & primes, const mpz_t & e, mpz_t & d ) {
+    if ( mpz_cmp_ui( e, 1 ) <= 0 ) {
+        return INVALID_PARAM_E;
+    }
     
-    mpz_sub_ui( p1, p, 1 );
-    mpz_sub_ui( q1, q, 1 );
-    mpz_mul( phi, p1, q1 );
+    mpz_t p1, phi, g;
+    mpz_inits( p1, phi, g, nullptr );
+    
+    mpz_set_ui( phi, 1 );
+    for ( const Mpz & p : primes ) {
+        mpz_sub_ui( p1, p.v, 1 );
+        mpz_lcm( phi, phi, p1 );
+    }
     
-    bool skipped = false;
     ReturnValues ret = SUCCESS;
-    do {
-        do {
-            do {
-                if ( !skip_e ) {
-                    ret = randomNumber( e, mpz_sizeinbase( phi, 2 ) );
-                    if ( ret != SUCCESS ) {
-                        goto clean;
-                    }
-                }
-                else if ( skipped ) {
-                    ret = INVALID_PARAM_E;
-                    goto clean;
-                }
-                else {
-                    skipped = true;
-                }
-            } while ( mpz_cmp_ui( e, 1 ) <= 0 || mpz_cmp( phi, e ) <= 0 );
-            gcd( g, e, phi );
-        } while ( mpz_cmp_ui( g, 1 ) != 0 );
-        invert( d, e, phi) ;
-        mpz_mul( mul, e, d );
-        mpz_mod( mod, mul, phi );
-    } while ( mpz_cmp_ui( mod, 1 ) != 0 );
+    gcd( g, e, phi );
+    if ( mpz_cmp_ui( g, 1 ) != 0 ) {
+        ret = INVALID_PARAM_E;
+    }
+    else {
+        mpz_mod( p1, e, phi );
+        invert( d, p1, phi );
+    }
     
-    clean:
-        mpz_clears( p1, q1, phi, g, mul, mod, nullptr );
+    mpz_clears( p1, phi, g, nullptr );
+    return ret;
+}
+
+/*
+ * Tests that p - 1 is coprime with public exponent, so e stays invertible
+ */
+bool fitsExponent( const mpz_t & p, const mpz_t & e ) {
+    if ( mpz_fits_ulong_p( e ) ) {
+        unsigned long a = mpz_get_ui( e );
+        unsigned long b = ( mpz_fdiv_ui( p, a ) + a - 1 ) % a;
+        while ( b ) {
+            unsigned long t = a % b;
+            a = b;
+            b = t;
+        }
+        return a == 1;
+    }
     
+    mpz_t p1, g;
+    mpz_inits( p1, g, nullptr );
+    mpz_sub_ui( p1, p, 1 );
+    gcd( g, e, p1 );
+    bool ret = mpz_cmp_ui( g, 1 ) == 0;
+    mpz_clears( p1, g, nullptr );
     return ret;
 }
 
 /*
- * Generates public and private keys
+ * Draws random primes of given size until one keeps public exponent e invertible
  */
-ReturnValues generate_key( size_t b, mpz_t & p, mpz_t & q, mpz_t & n, mpz_t & e, mpz_t & d ) {
-    size_t sizep = ( b >> 1 ) + b % 2;
-    size_t sizeq = ( b >> 1 );
-    do {
-        ReturnValues test = randomNumber( p, sizep, true );
+ReturnValues randomPrime( mpz_t & prime, size_t size, const mpz_t & e ) {
+    while ( true ) {
+        ReturnValues test = randomNumber( prime, size, true );
         if ( test != SUCCESS ) {
             return test;
         }
-    } while ( !isPrime( p, sizep ) );
-    
-    do {
-        ReturnValues test = randomNumber( q, sizeq, true );
+        STAT_INC( STAT_PRIME_CANDIDATES );
+        if ( !fitsExponent( prime, e ) ) {
+            STAT_INC( STAT_PRIME_REJECTED_EXPONENT );
+            continue;
+        }
+        if ( isPrime( prime, size ) ) {
+            return SUCCESS;
+        }
+        STAT_INC( STAT_PRIME_REJECTED_TEST );
+    }
+}
+
+/*
+ * Tests that i-th prime differs from all previous ones
+ */
+bool isDistinct( const MpzList & primes, size_t i ) {
+    for ( size_t j = 0; j < i; j++ ) {
+        if ( mpz_cmp( primes[i].v, primes[j].v ) == 0 ) {
+            STAT_INC( STAT_PRIME_REJECTED_DUPLICATE );
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Draws i-th prime of given size that differs from the previous ones. Tiny
+ * sizes with fewer primes than the key needs grow by a bit after
+ * DUPLICATE_RETRIES duplicates
+ */
+ReturnValues distinctPrime( MpzList & primes, size_t i, size_t size, const mpz_t & e ) {
+    for ( size_t attempt = 1; ; attempt++ ) {
+        ReturnValues test = randomPrime( primes[i].v, size, e );
+        if ( test != SUCCESS || isDistinct( primes, i ) ) {
+            return test;
+        }
+        if ( attempt % DUPLICATE_RETRIES == 0 ) {
+            size++;
+        }
+    }
+}
+
+/*
+ * Generates private key for given public exponent e, modulus is product of k distinct primes
+ */
+ReturnValues generate_key( size_t b, size_t k, MpzList & primes, mpz_t & n, const mpz_t & e, mpz_t & d ) {
+    STAT_TIME( TIMER_GENERATE );
+    if ( k < 2 || b < 2 * k ) {
+        return INVALID_ARGUMENTS;
+    }
+    if ( mpz_cmp_ui( e, 3 ) < 0 || mpz_even_p( e ) ) {
+        return INVALID_PARAM_E;
+    }
+    primes.assign( k, Mpz() );
+    mpz_set_ui( n, 1 );
+    for ( size_t i = 0; i < k; i++ ) {
+        size_t size = b / k + ( i < b % k ? 1 : 0 );
+        ReturnValues test = distinctPrime( primes, i, size, e );
         if ( test != SUCCESS ) {
             return test;
         }
-    } while ( !isPrime( q, sizeq ) );
+        mpz_mul( n, n, primes[i].v );
+    }
     
-    mpz_mul( n, p, q );
-    return computeKeys( p, q, e, d );
+    return computeKeys( primes, e, d );
+}
+
+/*
+ * Computes num^exp mod modulo for exponent that fits to machine word, left to right
+ */
+void powmShort( mpz_t & result, const mpz_t & num, unsigned long exp, const mpz_t & modulo ) {
+    STAT_INC( STAT_MODEXP_CALLS );
+    STAT_ADD( STAT_MODEXP_BITS, exp ? sizeof( exp ) * 8 - __builtin_clzl( exp ) : 0 );
+    if ( exp == 0 ) {
+        mpz_set_ui( result, 1 );
+        mpz_mod( result, result, modulo );
+        return;
+    }
+    if ( smallModulus( modulo ) ) {
+        powmSmall( result, num, exp, modulo );
+        return;
+    }
+    
+    mpz_t n;
+    mpz_init( n );
+    mpz_mod( n, num, modulo );
+    mpz_set( result, n );
+    for ( int bit = sizeof( exp ) * 8 - 2 - __builtin_clzl( exp ); bit >= 0; bit-- ) {
+        mpz_mul( result, result, result );
+        mpz_tdiv_r( result, result, modulo );
+        if ( ( exp >> bit ) & 1 ) {
+            mpz_mul( result, result, n );
+            mpz_tdiv_r( result, result, modulo );
+        }
+    }
+    mpz_clear( n );
 }
 
 /*
  * Encrypt message
  */
 ReturnValues encrypt( mpz_t & result, const mpz_t & e, const mpz_t & n, const mpz_t & message ) {
+    STAT_TIME( TIMER_ENCRYPT );
+    if ( mpz_fits_ulong_p( e ) ) {
+        powmShort( result, message, mpz_get_ui( e ), n );
+        return SUCCESS;
+    }
     powm( result, message, e, n);
     return SUCCESS;
 }
@@ -434,47 +631,305 @@ ReturnValues encrypt( mpz_t & result, const mpz_t & e, const mpz_t & n, const mp
  * Decrypts message
  */
 ReturnValues decrypt( mpz_t & result, const mpz_t & d, const mpz_t & n, const mpz_t & message ) {
+    STAT_TIME( TIMER_DECRYPT );
     powm( result, message, d, n);
     return SUCCESS;
 }
 
+/*
+ * Precomputes exponents and Garner coefficients for CRT decryption
+ */
+void prepareCrt( CrtKey & key, const MpzList & primes, const mpz_t & d ) {
+    key.primes = primes;
+    key.exponents.assign( primes.size(), Mpz() );
+    key.coefficients.assign( primes.size(), Mpz() );
+    
+    mpz_t p1, product;
+    mpz_inits( p1, product, nullptr );
+    mpz_set_ui( product, 1 );
+    for ( size_t i = 0; i < primes.size(); i++ ) {
+        mpz_sub_ui( p1, primes[i].v, 1 );
+        mpz_mod( key.exponents[i].v, d, p1 );
+        mpz_mod( p1, product, primes[i].v );
+        invert( key.coefficients[i].v, p1, primes[i].v );
+        mpz_mul( product, product, primes[i].v );
+    }
+    mpz_clears( p1, product, nullptr );
+}
+
+/*
+ * Decrypts message with k-way CRT, every exponentiation works modulo a single prime
+ */
+ReturnValues decryptCrt( mpz_t & result, const CrtKey & key, const mpz_t & message ) {
+    STAT_TIME( TIMER_DECRYPT );
+    mpz_t m, h, product;
+    mpz_inits( m, h, product, nullptr );
+    mpz_set_ui( result, 0 );
+    mpz_set_ui( product, 1 );
+    for ( size_t i = 0; i < key.primes.size(); i++ ) {
+        const mpz_t & p = key.primes[i].v;
+        powm( m, message, key.exponents[i].v, p );
+        mpz_sub( h, m, result );
+        mpz_mul( h, h, key.coefficients[i].v );
+        mpz_mod( h, h, p );
+        mpz_addmul( result, h, product );
+        mpz_mul( product, product, p );
+    }
+    mpz_clears( m, h, product, nullptr );
+    return SUCCESS;
+}
+
 /*
  * Compute primes that were used for key generations and decrypts message
  */
-ReturnValues unlimitedPower( mpz_t & p, mpz_t & q, mpz_t & decrypted, mpz_t & e, const mpz_t & n, const mpz_t & encrypted ) {
-    primeFactorPollard( p, q, n );
+ReturnValues unlimitedPower( mpz_t & p, mpz_t & q, mpz_t & decrypted, mpz_t & e, const mpz_t & n, const mpz_t & encrypted,
+                             size_t workers, const std::string & socketPath ) {
+    {
+        STAT_TIME( TIMER_FACTOR );
+        // Balanced moduli are out of reach of rho long before 2^128, moduli the sieve
+        // cannot take go to rho, distributed when workers are given
+        size_t bits   = mpz_sizeinbase( n, 2 );
+        bool   sieved = bits > SIQS_MIN_BITS && bits <= SIQS_MAX_BITS && factorSiqs( p, q, n ) == SUCCESS;
+        if ( !sieved && fitsSmall( n ) ) {
+            factorSmall( p, q, n );
+        }
+        else if ( !sieved && ( workers > 0 || !socketPath.empty() ) ) {
+            factorDistributed( p, q, n, workers, socketPath );
+        }
+        else if ( !sieved ) {
+            primeFactorPollard( p, q, n );
+        }
+    }
     //primeFactor( p, q, n );
-    if ( mpz_cmp_ui( p, 0 ) == 0 || mpz_cmp_ui( q, 0 ) == 0 ) {
+    if ( mpz_cmp_ui( p, 1 ) <= 0 || mpz_cmp_ui( q, 1 ) <= 0 ) {
         return INVALID_PARAM_N;
     }
+    if ( mpz_cmp( p, q ) > 0 ) {
+        mpz_swap( p, q );
+    }
+    MpzList primes( 2 );
+    mpz_set( primes[0].v, p );
+    mpz_set( primes[1].v, q );
+    
     mpz_t d;
     mpz_init( d );
-    ReturnValues ret = computeKeys( p, q, e, d, true );
+    ReturnValues ret = computeKeys( primes, e, d );
     
     if ( ret == SUCCESS ) {
-        ret = decrypt( decrypted, d, n, encrypted );
+        CrtKey key;
+        prepareCrt( key, primes, d );
+        ret = decryptCrt( decrypted, key, encrypted );
     }
     mpz_clear( d );
     return ret;
 }
 
+/*
+ * Converts whitespace separated hexadecimal numbers to binary container,
+ * key containers take one key per line
+ */
+ReturnValues hex2bin( const std::string & input, const std::string & output, ContainerKind kind ) {
+    std::ifstream file( input, std::ios::binary | std::ios::ate );
+    if ( !file.is_open() ) {
+        return FILE_ACCESS_FAIL;
+    }
+    std::vector<char> text( static_cast<size_t>( file.tellg() ) + 1 );
+    file.seekg( 0, std::ios::beg );
+    if ( !file.read( text.data(), text.size() - 1 ) ) {
+        return FILE_ACCESS_FAIL;
+    }
+    text.back() = '\0';
+
+    size_t width = 1;
+    if ( kind == CONTAINER_KEY ) {
+        std::istringstream firstLine( std::string( text.data(), std::strcspn( text.data(), "\n" ) ) );
+        std::string token;
+        for ( width = 0; firstLine >> token; width++ );
+        if ( width < 5 ) {
+            return INVALID_FILE_FORMAT;
+        }
+    }
+
+    ContainerWriter writer;
+    ReturnValues ret = writer.open( output, kind, width );
+    mpz_t num;
+    mpz_init( num );
+    size_t count = 0;
+    for ( char * token = std::strtok( text.data(), " \t\r\n" ); token && ret == SUCCESS; token = std::strtok( nullptr, " \t\r\n" ) ) {
+        if ( !isHexaDecimal( token ) || mpz_set_str( num, token + 2, 16 ) ) {
+            ret = INVALID_FILE_FORMAT;
+            break;
+        }
+        ret = writer.append( num );
+        count++;
+    }
+    mpz_clear( num );
+
+    if ( ret == SUCCESS && count % width != 0 ) {
+        ret = INVALID_FILE_FORMAT;
+    }
+    ReturnValues closed = writer.close();
+    return ret == SUCCESS ? closed : ret;
+}
+
+/*
+ * Prints binary container in hexadecimal format, one item per line
+ */
+ReturnValues bin2hex( const std::string & input ) {
+    ContainerReader reader;
+    ReturnValues ret = reader.open( input );
+    if ( ret != SUCCESS ) {
+        return ret;
+    }
+
+    mpz_t num;
+    mpz_init( num );
+    std::vector<char> digits;
+    std::string out;
+    out.reserve( 1 << 20 );
+    for ( size_t i = 0; i < reader.size(); i++ ) {
+        reader.get( num, i );
+        digits.resize( mpz_sizeinbase( num, FORMAT ) + 2 );
+        mpz_get_str( digits.data(), FORMAT, num );
+        out += PREFIX;
+        out += digits.data();
+        out += ( i + 1 ) % reader.width() ? ' ' : '\n';
+        if ( out.size() >= ( 1 << 20 ) ) {
+            std::fwrite( out.data(), 1, out.size(), stdout );
+            out.clear();
+        }
+    }
+    std::fwrite( out.data(), 1, out.size(), stdout );
+    mpz_clear( num );
+    return SUCCESS;
+}
+
+/*
+ * Checks that at least two distinct factors above one multiply to n
+ */
+static bool factorsModulus( const MpzList & primes, const mpz_t & n ) {
+    if ( primes.size() < 2 ) {
+        return false;
+    }
+    mpz_t product;
+    mpz_init_set_ui( product, 1 );
+    bool valid = true;
+    for ( size_t i = 0; i < primes.size() && valid; i++ ) {
+        valid = mpz_cmp_ui( primes[i].v, 1 ) > 0;
+        for ( size_t j = 0; j < i && valid; j++ ) {
+            valid = mpz_cmp( primes[i].v, primes[j].v ) != 0;
+        }
+        mpz_mul( product, product, primes[i].v );
+    }
+    valid = valid && mpz_cmp( product, n ) == 0;
+    mpz_clear( product );
+    return valid;
+}
+
+/*
+ * Encrypts or decrypts every record of input container with key from key container
+ */
+ReturnValues processBatch( const std::string & keyFile, const std::string & input, const std::string & output, bool decryption ) {
+    ContainerReader key, data;
+    ReturnValues ret = key.open( keyFile );
+    if ( ret != SUCCESS ) {
+        return ret;
+    }
+    if ( key.kind() != CONTAINER_KEY || key.size() < 5 ) {
+        return INVALID_FILE_FORMAT;
+    }
+    ret = data.open( input );
+    if ( ret != SUCCESS ) {
+        return ret;
+    }
+
+    size_t width = key.width();
+    mpz_t n, exp, message, result;
+    mpz_inits( n, exp, message, result, nullptr );
+    key.get( n, width - 3 );
+    key.get( exp, decryption ? width - 1 : width - 2 );
+    
+    CrtKey crt;
+    if ( decryption ) {
+        MpzList primes( width - 3 );
+        for ( size_t i = 0; i < primes.size(); i++ ) {
+            key.get( primes[i].v, i );
+        }
+        prepareCrt( crt, primes, exp );
+    }
+
+    ContainerWriter writer;
+    ret = writer.open( output, CONTAINER_BATCH, 1 );
+    for ( size_t i = 0; i < data.size() && ret == SUCCESS; i++ ) {
+        data.get( message, i );
+        ret = decryption ? decryptCrt( result, crt, message ) : encrypt( result, exp, n, message );
+        if ( ret == SUCCESS ) {
+            ret = writer.append( result );
+        }
+    }
+    ReturnValues closed = writer.close();
+
+    mpz_clears( n, exp, message, result, nullptr );
+    return ret == SUCCESS ? closed : ret;
+}
+
+#ifndef KRY_NO_MAIN
 int main( int argc, const char ** argv ) {
+    bool stats = false;
+    bool pool  = false;
+    size_t workers = 0;
+    std::string socketPath;
+    std::vector<const char *> args;
+    for ( int i = 0; i < argc; i++ ) {
+        if ( std::string( argv[i] ) == "--stats" ) {
+            stats = true;
+        }
+        else if ( std::string( argv[i] ) == "--workers" && i + 1 < argc && isUnsigned( argv[i + 1] ) ) {
+            workers = std::atoi( argv[++i] );
+        }
+        else if ( std::string( argv[i] ) == "--socket" && i + 1 < argc ) {
+            socketPath = argv[++i];
+        }
+        else if ( std::string( argv[i] ) == "--pool" ) {
+            pool = true;
+        }
+        else {
+            args.push_back( argv[i] );
+        }
+    }
+    argc = args.size();
+    argv = args.data();
+    
     Settings     mode      = parseArguments( argc, argv );
     ReturnValues ret_value = SUCCESS;
     
     if ( mode == GENERATE ) {
-        mpz_t p, q, n, e, d;
-        mpz_inits( p, q, n, e, d, nullptr );
-        ret_value = generate_key( std::atoi( argv[2] ), p, q, n, e, d );
+        MpzList primes;
+        mpz_t n, e, d;
+        mpz_inits( n, e, d, nullptr );
+        size_t k = argc > 3 ? std::atoi( argv[3] ) : 2;
+        if ( argc > 4 ) {
+            mpz_set_str( e, argv[4] + 2, 16 );
+        }
+        else {
+            mpz_set_ui( e, DEFAULT_E );
+        }
+        if ( pool ) {
+            ret_value = generateKeyPooled( std::atoi( argv[2] ), k, primes, n, e, d );
+        }
+        else {
+            ret_value = generate_key( std::atoi( argv[2] ), k, primes, n, e, d );
+        }
         if ( ret_value == SUCCESS ) {
-            char * p_str = mpz_get_str( nullptr, FORMAT, p );
-            char * q_str = mpz_get_str( nullptr, FORMAT, q );
+            for ( const Mpz & p : primes ) {
+                char * p_str = mpz_get_str( nullptr, FORMAT, p.v );
+                std::cout << PREFIX << p_str << ' ';
+                free( p_str );
+            }
             char * n_str = mpz_get_str( nullptr, FORMAT, n );
             char * e_str = mpz_get_str( nullptr, FORMAT, e );
             char * d_str = mpz_get_str( nullptr, FORMAT, d );
-            std::cout << PREFIX << p_str << ' ' << PREFIX << q_str << ' ' << PREFIX << n_str << ' ' << PREFIX << e_str << ' ' << PREFIX << d_str << std::endl;
-            free( p_str );
-            free( q_str );
+            std::cout << PREFIX << n_str << ' ' << PREFIX << e_str << ' ' << PREFIX << d_str << std::endl;
             free( n_str );
             free( e_str );
             free( d_str );
@@ -482,7 +937,7 @@ int main( int argc, const char ** argv ) {
         else {
             std::cerr << "Task Failed" << std::endl;
         }
-        mpz_clears( p, q, n, e, d, nullptr );
+        mpz_clears( n, e, d, nullptr );
     }
     else if ( mode == DECRYPT ) {
         mpz_t d, n, message, result;
@@ -490,8 +945,22 @@ int main( int argc, const char ** argv ) {
         int flag1 = mpz_set_str( d, argv[2] + 2, 16 );
         int flag2 = mpz_set_str( n, argv[3] + 2, 16 );
         int flag3 = mpz_set_str( message, argv[4] + 2, 16 );
+        MpzList primes( argc - 5 );
+        for ( int i = 5; i < argc; i++ ) {
+            flag3 |= mpz_set_str( primes[i - 5].v, argv[i] + 2, 16 );
+        }
         if ( !flag1 && !flag2 && !flag3 ) {
-            ret_value = decrypt( result, d, n, message);
+            if ( primes.empty() ) {
+                ret_value = decrypt( result, d, n, message);
+            }
+            else if ( !factorsModulus( primes, n ) ) {
+                ret_value = INVALID_PARAM_N;
+            }
+            else {
+                CrtKey key;
+                prepareCrt( key, primes, d );
+                ret_value = decryptCrt( result, key, message );
+            }
             if ( ret_value  == SUCCESS ) {
                 char * decrypted( mpz_get_str( nullptr, FORMAT, result ) );
                 std::cout << PREFIX << decrypted << std::endl;
@@ -537,7 +1006,7 @@ int main( int argc, const char ** argv ) {
         int flag2 = mpz_set_str( n, argv[3] + 2, 16 );
         int flag3 = mpz_set_str( encrypted, argv[4] + 2, 16 );
         if ( !flag1 && !flag2 && !flag3 ) {
-            ret_value = unlimitedPower( p, q, decrypted, e, n, encrypted );
+            ret_value = unlimitedPower( p, q, decrypted, e, n, encrypted, workers, socketPath );
             if ( ret_value  == SUCCESS ) {
                 char * p_str   = mpz_get_str( nullptr, FORMAT, p );
                 char * q_str   = mpz_get_str( nullptr, FORMAT, q );
@@ -557,9 +1026,65 @@ int main( int argc, const char ** argv ) {
         }
         mpz_clears(  p, q, e, n, encrypted, decrypted, nullptr );
     }
+    else if ( mode == HEX2BIN ) {
+        ContainerKind kind = std::string( argv[2] ) == "key" ? CONTAINER_KEY : CONTAINER_BATCH;
+        ret_value = hex2bin( argv[3], argv[4], kind );
+        if ( ret_value != SUCCESS ) {
+            std::cerr << "Task Failed" << std::endl;
+        }
+    }
+    else if ( mode == BIN2HEX ) {
+        ret_value = bin2hex( argv[2] );
+        if ( ret_value != SUCCESS ) {
+            std::cerr << "Task Failed" << std::endl;
+        }
+    }
+    else if ( mode == GENERATE_MANY ) {
+        mpz_t e;
+        mpz_init_set_ui( e, DEFAULT_E );
+        ret_value = generateKeys( std::atoi( argv[2] ), 2, std::atoi( argv[4] ), e, argv[5], argc == 7 );
+        if ( ret_value != SUCCESS ) {
+            std::cerr << "Task Failed" << std::endl;
+        }
+        mpz_clear( e );
+    }
+    else if ( mode == POOL ) {
+        std::string action = argv[2];
+        size_t bits = std::atoi( argv[3] );
+        if ( action == "info" ) {
+            PrimePool primes;
+            ret_value = primes.open( bits );
+            if ( ret_value == SUCCESS ) {
+                std::cout << primes.path() << ' ' << primes.bits() << ' ' << primes.size() << ' ' << primes.capacity() << std::endl;
+            }
+        }
+        else {
+            ret_value = fillPool( bits, argc == 5 ? std::atoi( argv[4] ) : PRIME_POOL_CAPACITY, action == "keep" );
+        }
+        if ( ret_value != SUCCESS ) {
+            std::cerr << "Task Failed" << std::endl;
+        }
+    }
+    else if ( mode == WORKER ) {
+        ret_value = runWorker( argv[2] );
+        if ( ret_value != SUCCESS ) {
+            std::cerr << "Task Failed" << std::endl;
+        }
+    }
+    else if ( mode == ENCRYPT_BATCH || mode == DECRYPT_BATCH ) {
+        ret_value = processBatch( argv[2], argv[3], argv[4], mode == DECRYPT_BATCH );
+        if ( ret_value != SUCCESS ) {
+            std::cerr << "Task Failed" << std::endl;
+        }
+    }
     else {
         std::cerr << "Invalid arguments." << std::endl; ret_value = INVALID_ARGUMENTS;
     }
     
+    if ( stats ) {
+        printStats( std::cerr );
+    }
+    
     return ret_value;
 }
+#endif
@@ -0,0 +1,65 @@
+#ifndef KRY_H
+#define KRY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <gmp.h>
+
+enum ReturnValues { SUCCESS = 0, INVALID_ARGUMENTS, MPZ_INIT_FAIL, FILE_ACCESS_FAIL, INVALID_PARAM_E, INVALID_PARAM_N, INVALID_FILE_FORMAT };
+
+/*
+ * Owning mpz_t that can live in standard containers
+ */
+struct Mpz {
+    mpz_t v;
+
+    Mpz()                   { mpz_init( v ); }
+    Mpz( const Mpz & other ) { mpz_init_set( v, other.v ); }
+    ~Mpz()                  { mpz_clear( v ); }
+
+    Mpz & operator=( const Mpz & other ) {
+        mpz_set( v, other.v );
+        return *this;
+    }
+};
+
+typedef std::vector<Mpz> MpzList;
+
+const unsigned long DEFAULT_E = 65537;
+
+/*
+ * Precomputed values for k-way CRT decryption
+ */
+struct CrtKey {
+    MpzList primes;
+    MpzList exponents;    // d mod ( p_i - 1 )
+    MpzList coefficients; // ( p_1 * ... * p_i-1 )^-1 mod p_i
+};
+
+void setRandomSeed( unsigned long seed );
+ReturnValues randomNumber( mpz_t & result, size_t bits, bool mask = false );
+void invert( mpz_t & result, const mpz_t & num, const mpz_t & modulo );
+void gcd( mpz_t & result, const mpz_t & a, const mpz_t & b );
+void powm( mpz_t & result, const mpz_t & num, const mpz_t & exp, const mpz_t & modulo );
+bool isPrime( const mpz_t & n, size_t primeSize, size_t iterations = 30 );
+ReturnValues primeFactorPollard( mpz_t & p, mpz_t & q, const mpz_t & n );
+void powmShort( mpz_t & result, const mpz_t & num, unsigned long exp, const mpz_t & modulo );
+bool fitsExponent( const mpz_t & p, const mpz_t & e );
+ReturnValues randomPrime( mpz_t & prime, size_t size, const mpz_t & e );
+bool isDistinct( const MpzList & primes, size_t i );
+ReturnValues distinctPrime( MpzList & primes, size_t i, size_t size, const mpz_t & e );
+ReturnValues computeKeys( const MpzList & primes, const mpz_t & e, mpz_t & d );
+ReturnValues generate_key( size_t b, size_t k, MpzList & primes, mpz_t & n, const mpz_t & e, mpz_t & d );
+ReturnValues encrypt( mpz_t & result, const mpz_t & e, const mpz_t & n, const mpz_t & message );
+ReturnValues decrypt( mpz_t & result, const mpz_t & d, const mpz_t & n, const mpz_t & message );
+void prepareCrt( CrtKey & key, const MpzList & primes, const mpz_t & d );
+ReturnValues decryptCrt( mpz_t & result, const CrtKey & key, const mpz_t & message );
+/*
+ * Factors n and decrypts message, workers > 0 or non empty socketPath hands
+ * factoring to distributed coordinator (distrib.h)
+ */
+ReturnValues unlimitedPower( mpz_t & p, mpz_t & q, mpz_t & decrypted, mpz_t & e, const mpz_t & n, const mpz_t & encrypted,
+                             size_t workers = 0, const std::string & socketPath = "" );
+
+#endif
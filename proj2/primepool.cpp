@@ -0,0 +1,285 @@
+#include "primepool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "keygen.h"
+#include "stats.h"
+
+static const char MAGIC[4] = { 'K', 'R', 'Y', 'P' };
+static const int  VERSION  = 1;
+
+// Seconds between two looks at a kept pool
+static const unsigned KEEP_POLL = 1;
+
+// Miller-Rabin rounds on a popped prime
+static const size_t POP_ROUNDS = 16;
+
+static uint64_t readLittle( const unsigned char * data, size_t bytes ) {
+    uint64_t value = 0;
+    for ( size_t i = bytes; i-- > 0; ) {
+        value = ( value << 8 ) | data[i];
+    }
+    return value;
+}
+
+static void writeLittle( unsigned char * data, uint64_t value, size_t bytes ) {
+    for ( size_t i = 0; i < bytes; i++ ) {
+        data[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+/*
+ * Holds flock on pool file together with mutex of the object
+ */
+class PoolLock {
+public:
+    PoolLock( std::mutex & mutex, int fd, int operation ) : lock_( mutex ), fd_( fd ) {
+        while ( flock( fd_, operation ) != 0 && errno == EINTR );
+    }
+    ~PoolLock() {
+        flock( fd_, LOCK_UN );
+    }
+
+private:
+    std::lock_guard<std::mutex> lock_;
+    int                         fd_;
+};
+
+/*
+ * $KRY_POOL, else PRIME_POOL_DIR in $XDG_RUNTIME_DIR or hidden in $HOME,
+ * empty when none is set
+ */
+static std::string poolDirectory() {
+    const char * dir = std::getenv( "KRY_POOL" );
+    if ( dir && *dir ) {
+        return dir;
+    }
+    dir = std::getenv( "XDG_RUNTIME_DIR" );
+    if ( dir && *dir ) {
+        return std::string( dir ) + '/' + PRIME_POOL_DIR;
+    }
+    dir = std::getenv( "HOME" );
+    if ( dir && *dir ) {
+        return std::string( dir ) + "/." + PRIME_POOL_DIR;
+    }
+    return std::string();
+}
+
+/*
+ * Descriptor is ours alone, other users could swap or read primes otherwise
+ */
+static bool isPrivate( int fd, mode_t type, mode_t mode ) {
+    struct stat info;
+    return fstat( fd, &info ) == 0 && ( info.st_mode & S_IFMT ) == type && info.st_uid == getuid() &&
+           ( info.st_mode & 07777 ) == mode;
+}
+
+PrimePool::PrimePool() : fd_( -1 ), data_( nullptr ), length_( 0 ), bits_( 0 ), capacity_( 0 ), slot_( 0 ) {}
+
+PrimePool::~PrimePool() {
+    close();
+}
+
+ReturnValues PrimePool::open( size_t bits, bool create, size_t capacity ) {
+    close();
+    std::string directory = poolDirectory();
+    if ( directory.empty() || ( create && mkdir( directory.c_str(), 0700 ) != 0 && errno != EEXIST ) ) {
+        return FILE_ACCESS_FAIL;
+    }
+    int dirFd = ::open( directory.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW );
+    if ( dirFd < 0 ) {
+        return FILE_ACCESS_FAIL;
+    }
+    std::string name = "primes-" + std::to_string( bits ) + ".pool";
+    path_ = directory + '/' + name;
+    if ( isPrivate( dirFd, S_IFDIR, 0700 ) ) {
+        fd_ = openat( dirFd, name.c_str(), ( create ? O_RDWR | O_CREAT : O_RDWR ) | O_NOFOLLOW, 0600 );
+    }
+    ::close( dirFd );
+    if ( fd_ < 0 ) {
+        return FILE_ACCESS_FAIL;
+    }
+    if ( !isPrivate( fd_, S_IFREG, 0600 ) ) {
+        close();
+        return FILE_ACCESS_FAIL;
+    }
+
+    ReturnValues ret = SUCCESS;
+    slot_ = ( bits + 7 ) / 8;
+    {
+        PoolLock lock( mutex_, fd_, LOCK_EX );
+        struct stat info;
+        if ( fstat( fd_, &info ) != 0 ) {
+            ret = FILE_ACCESS_FAIL;
+        }
+        else if ( info.st_size == 0 && create ) {
+            unsigned char header[PRIME_POOL_HEADER] = {};
+            std::memcpy( header, MAGIC, 4 );
+            header[4] = VERSION;
+            writeLittle( header + 8, bits, 4 );
+            writeLittle( header + 16, capacity, 8 );
+            length_ = PRIME_POOL_HEADER + capacity * slot_;
+            if ( ftruncate( fd_, length_ ) != 0 || pwrite( fd_, header, sizeof( header ), 0 ) != sizeof( header ) ) {
+                ret = FILE_ACCESS_FAIL;
+            }
+        }
+        else {
+            length_ = info.st_size;
+        }
+
+        void * map = MAP_FAILED;
+        if ( ret == SUCCESS && length_ >= PRIME_POOL_HEADER ) {
+            map = mmap( nullptr, length_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0 );
+        }
+        if ( ret == SUCCESS && map == MAP_FAILED ) {
+            ret = length_ < PRIME_POOL_HEADER ? INVALID_FILE_FORMAT : FILE_ACCESS_FAIL;
+        }
+        if ( ret == SUCCESS ) {
+            data_     = static_cast<unsigned char *>( map );
+            bits_     = readLittle( data_ + 8, 4 );
+            capacity_ = readLittle( data_ + 16, 8 );
+            if ( std::memcmp( data_, MAGIC, 4 ) != 0 || data_[4] != VERSION || bits_ != bits ||
+                 capacity_ > ( length_ - PRIME_POOL_HEADER ) / slot_ || readLittle( data_ + 24, 8 ) > capacity_ ) {
+                ret = INVALID_FILE_FORMAT;
+            }
+        }
+    }
+    if ( ret != SUCCESS ) {
+        close();
+    }
+    return ret;
+}
+
+void PrimePool::close() {
+    if ( data_ ) {
+        munmap( data_, length_ );
+        data_ = nullptr;
+    }
+    if ( fd_ >= 0 ) {
+        ::close( fd_ );
+        fd_ = -1;
+    }
+    length_ = bits_ = capacity_ = 0;
+}
+
+size_t PrimePool::size() {
+    PoolLock lock( mutex_, fd_, LOCK_SH );
+    return readLittle( data_ + 24, 8 );
+}
+
+bool PrimePool::pop( mpz_t & prime ) {
+    while ( true ) {
+        {
+            PoolLock lock( mutex_, fd_, LOCK_EX );
+            uint64_t count = readLittle( data_ + 24, 8 );
+            if ( count == 0 ) {
+                STAT_INC( STAT_POOL_MISSES );
+                return false;
+            }
+            count--;
+            mpz_import( prime, slot_, 1, 1, 0, 0, data_ + PRIME_POOL_HEADER + count * slot_ );
+            writeLittle( data_ + 24, count, 8 );
+        }
+        // Tested without the lock, a damaged entry is simply dropped
+        if ( mpz_sizeinbase( prime, 2 ) == bits_ && isPrime( prime, bits_, POP_ROUNDS ) ) {
+            STAT_INC( STAT_POOL_HITS );
+            return true;
+        }
+    }
+}
+
+bool PrimePool::push( const mpz_t & prime ) {
+    // Keys built from pooled primes have to get the modulus size they asked for
+    if ( mpz_sizeinbase( prime, 2 ) != bits_ ) {
+        return false;
+    }
+    PoolLock lock( mutex_, fd_, LOCK_EX );
+    uint64_t count = readLittle( data_ + 24, 8 );
+    if ( count >= capacity_ ) {
+        return false;
+    }
+    unsigned char * slot = data_ + PRIME_POOL_HEADER + count * slot_;
+    mpz_export( slot, nullptr, 1, 1, 0, 0, prime );
+    writeLittle( data_ + 24, count + 1, 8 );
+    return true;
+}
+
+ReturnValues fillPool( size_t bits, size_t target, bool keep, size_t threads ) {
+    PrimePool pool;
+    ReturnValues ret = pool.open( bits, true, std::max( target, PRIME_POOL_CAPACITY ) );
+    if ( ret != SUCCESS ) {
+        return ret;
+    }
+    target = std::min( target, pool.capacity() );
+
+    // Linux applies the policy to calling thread, pipeline threads inherit it
+    sched_param param = {};
+    sched_setscheduler( 0, SCHED_IDLE, &param );
+
+    mpz_t e;
+    mpz_init_set_ui( e, DEFAULT_E );
+    while ( ret == SUCCESS ) {
+        if ( pool.size() < target ) {
+            ret = generatePrimes( bits, e, [&]( const mpz_t & prime ) {
+                return pool.push( prime ) && pool.size() < target;
+            }, threads );
+        }
+        if ( !keep ) {
+            break;
+        }
+        while ( pool.size() > target / 2 ) {
+            sleep( KEEP_POLL );
+        }
+    }
+    mpz_clear( e );
+    return ret;
+}
+
+ReturnValues generateKeyPooled( size_t b, size_t k, MpzList & primes, mpz_t & n, const mpz_t & e, mpz_t & d ) {
+    STAT_TIME( TIMER_GENERATE );
+    if ( k < 2 || b < 2 * k ) {
+        return INVALID_ARGUMENTS;
+    }
+    if ( mpz_cmp_ui( e, 3 ) < 0 || mpz_even_p( e ) ) {
+        return INVALID_PARAM_E;
+    }
+    primes.assign( k, Mpz() );
+    mpz_set_ui( n, 1 );
+    for ( size_t i = 0; i < k; i++ ) {
+        size_t size = b / k + ( i < b % k ? 1 : 0 );
+        PrimePool pool;
+        bool pooled = pool.open( size ) == SUCCESS;
+        MpzList skipped;
+        bool found;
+        do {
+            // Pool is filled for DEFAULT_E, primes that do not fit other exponent go back
+            found = false;
+            while ( pooled && !found && pool.pop( primes[i].v ) ) {
+                found = fitsExponent( primes[i].v, e );
+                if ( !found ) {
+                    skipped.push_back( Mpz() );
+                    mpz_set( skipped.back().v, primes[i].v );
+                }
+            }
+        } while ( found && !isDistinct( primes, i ) );
+        for ( size_t j = skipped.size(); j-- > 0; ) {
+            pool.push( skipped[j].v );
+        }
+        ReturnValues test = found ? SUCCESS : distinctPrime( primes, i, size, e );
+        if ( test != SUCCESS ) {
+            return test;
+        }
+        mpz_mul( n, n, primes[i].v );
+    }
+
+    return computeKeys( primes, e, d );
+}
@@ -0,0 +1,85 @@
+#ifndef PRIMEPOOL_H
+#define PRIMEPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <gmp.h>
+#include "kry.h"
+
+/*
+ * Persistent pool of validated primes of one bit size, file "primes-BITS.pool"
+ * in $KRY_POOL, $XDG_RUNTIME_DIR/PRIME_POOL_DIR or $HOME/.PRIME_POOL_DIR. The
+ * file is memory mapped and shared by every process of the user, flock()
+ * serializes pushes and pops between them. Directory and file are refused
+ * unless owned by the user with modes 0700 and 0600, popped primes are tested
+ * again before use.
+ *
+ * Layout, all header integers are little endian:
+ *   char[4]  magic "KRYP"
+ *   uint8    version
+ *   uint8[3] reserved
+ *   uint32   bits
+ *   uint64   capacity
+ *   uint64   count
+ *   capacity times: ( bits + 7 ) / 8 bytes of big endian prime, first count used
+ */
+const char * const PRIME_POOL_DIR      = "kry-pool";
+const size_t       PRIME_POOL_CAPACITY = 4096;
+const size_t       PRIME_POOL_HEADER   = 32;
+
+class PrimePool {
+public:
+    PrimePool();
+    ~PrimePool();
+
+    /*
+     * Maps pool of given size, create makes missing file with given capacity
+     */
+    ReturnValues open( size_t bits, bool create = false, size_t capacity = PRIME_POOL_CAPACITY );
+    void close();
+
+    size_t bits()     const { return bits_; }
+    size_t capacity() const { return capacity_; }
+    size_t size();
+    const std::string & path() const { return path_; }
+
+    /*
+     * Takes most recently added prime, entries that fail primality test are
+     * dropped, false on empty pool
+     */
+    bool pop( mpz_t & prime );
+
+    /*
+     * Adds prime, false on full pool or prime of other size than bits()
+     */
+    bool push( const mpz_t & prime );
+
+private:
+    PrimePool( const PrimePool & );
+    PrimePool & operator=( const PrimePool & );
+
+    int             fd_;
+    unsigned char * data_;
+    size_t          length_;
+    size_t          bits_;
+    size_t          capacity_;
+    size_t          slot_;
+    std::string     path_;
+    std::mutex      mutex_;  // flock does not exclude threads sharing one descriptor
+};
+
+/*
+ * Fills pool of given size up to target primes with keygen pipeline at idle
+ * priority, keep makes it wait and refill whenever half of target is taken
+ */
+ReturnValues fillPool( size_t bits, size_t target, bool keep = false, size_t threads = 0 );
+
+/*
+ * generate_key that pops its primes from pools, sizes with empty or missing
+ * pool fall back to random search
+ */
+ReturnValues generateKeyPooled( size_t b, size_t k, MpzList & primes, mpz_t & n, const mpz_t & e, mpz_t & d );
+
+#endif
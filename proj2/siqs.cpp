@@ -0,0 +1,780 @@
+#include "siqs.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "stats.h"
+
+// One sieve block fits to L1 data cache
+static const size_t BLOCK_SIZE = 32768;
+
+// Primes from here on hit a block only a few times and are sieved over whole interval at once
+static const uint32_t LARGE_SIEVE_PRIME = 8192;
+
+// Bits below the largest partial relation value still reported by the sieve,
+// covers log rounding and points that are not at the maximum of g( x )
+static const double THRESHOLD_SLACK = 9;
+
+// Sieve bytes start at 128 - threshold and candidates reach 128, so larger
+// thresholds of big moduli scale logs down instead of wrapping the start value
+static const double MAX_THRESHOLD = 127;
+
+// Relations collected above number of factor base primes
+static const size_t EXTRA_RELATIONS = 64;
+
+// Rounds of more relations when every dependency gives trivial factor
+static const int SOLVE_ATTEMPTS = 4;
+
+// Worker gives up when it cannot find unused A, happens only for tiny moduli
+static const size_t MAX_FAILED_A = 10000;
+
+/*
+ * Factor base size, sieve blocks per half of interval and large prime bound
+ * as multiple of largest factor base prime, picked by modulus bits
+ */
+struct SiqsParams {
+    size_t   bits;
+    size_t   primes;
+    size_t   blocks;
+    unsigned largeMultiplier;
+};
+
+static const SiqsParams PARAMS[] = {
+    { 140,   300, 1,  40 },
+    { 160,   600, 1,  50 },
+    { 180,  1200, 1,  60 },
+    { 200,  3000, 2,  80 },
+    { 215,  5000, 2, 100 },
+    { 235,  7000, 3, 100 },
+    { 250, 10000, 3, 110 },
+    { 270, 14000, 4, 120 },
+    { 300, 20000, 5, 128 },
+    { 330, 26000, 6, 128 },
+    { 360, 32000, 8, 128 }
+};
+
+static const unsigned MULTIPLIERS[] = { 1, 2, 3, 5, 6, 7, 10, 11, 13, 14, 15, 17, 19, 21, 22, 23, 26, 29, 30, 31, 33,
+                                        34, 35, 37, 38, 39, 41, 42, 43, 46, 47, 51, 53, 55, 57, 58, 59, 61, 62, 65, 66,
+                                        67, 69, 70, 71, 73 };
+
+static uint64_t powMod( uint64_t base, uint64_t exp, uint64_t p ) {
+    uint64_t result = 1;
+    base %= p;
+    while ( exp ) {
+        if ( exp & 1 ) {
+            result = result * base % p;
+        }
+        base = base * base % p;
+        exp >>= 1;
+    }
+    return result;
+}
+
+static uint32_t inverseMod( uint32_t a, uint32_t p ) {
+    int64_t  t = 0, newT = 1;
+    uint32_t r = p, newR = a % p;
+    while ( newR ) {
+        uint32_t quotient = r / newR;
+        t = t - quotient * newT;
+        std::swap( t, newT );
+        r = r - quotient * newR;
+        std::swap( r, newR );
+    }
+    return t < 0 ? t + p : t;
+}
+
+/*
+ * Square root of a modulo odd prime p, a has to be a quadratic residue (Tonelli-Shanks)
+ */
+static uint32_t sqrtMod( uint32_t a, uint32_t p ) {
+    if ( a == 0 ) {
+        return 0;
+    }
+    if ( p % 4 == 3 ) {
+        return powMod( a, ( p + 1 ) / 4, p );
+    }
+    uint64_t q = p - 1;
+    int      s = 0;
+    while ( q % 2 == 0 ) {
+        q /= 2;
+        s++;
+    }
+    uint64_t z = 2;
+    while ( powMod( z, ( p - 1 ) / 2, p ) != p - 1 ) {
+        z++;
+    }
+    uint64_t c = powMod( z, q, p ), r = powMod( a, ( q + 1 ) / 2, p ), t = powMod( a, q, p );
+    while ( t != 1 ) {
+        int      i  = 0;
+        uint64_t t2 = t;
+        while ( t2 != 1 ) {
+            t2 = t2 * t2 % p;
+            i++;
+        }
+        uint64_t b = c;
+        for ( int j = 0; j < s - i - 1; j++ ) {
+            b = b * b % p;
+        }
+        r = r * b % p;
+        c = b * b % p;
+        t = t * c % p;
+        s = i;
+    }
+    return r;
+}
+
+/*
+ * Odd primes below limit
+ */
+static std::vector<uint32_t> oddPrimes( uint32_t limit ) {
+    std::vector<bool>     composite( limit, false );
+    std::vector<uint32_t> primes;
+    for ( uint32_t i = 3; i < limit; i += 2 ) {
+        if ( composite[i] ) {
+            continue;
+        }
+        primes.push_back( i );
+        for ( uint64_t j = static_cast<uint64_t>( i ) * i; j < limit; j += 2 * i ) {
+            composite[j] = true;
+        }
+    }
+    return primes;
+}
+
+/*
+ * Right side of ( A x + b )^2 - kN = A g( x ) split to factor base indices, index 0
+ * stands for -1. Large is 1 for full relation, otherwise the prime left after
+ * trial division, joined relation keeps it as its square divides the right side
+ */
+struct Relation {
+    Mpz                   y;
+    std::vector<uint32_t> factors;
+    uint64_t              large;
+};
+
+class Siqs {
+public:
+    explicit Siqs( const mpz_t & n );
+
+    /*
+     * Builds factor base, returns prime dividing n found on the way or 0
+     */
+    uint32_t prepare();
+
+    /*
+     * Sieves until target full relations are collected
+     */
+    void collect( size_t target, size_t threads );
+
+    /*
+     * Tries every dependency, sets p * q = n on success
+     */
+    bool solve( mpz_t & p, mpz_t & q );
+
+    size_t primes()    const { return primes_.size(); }
+    size_t relations() const { return relations_.size(); }
+
+private:
+    void     selectMultiplier();
+    void     sieveWorker( unsigned id );
+    bool     chooseA( std::mt19937_64 & random, std::vector<uint32_t> & chosen, mpz_t & a );
+    void     store( std::vector<Relation> & relations, std::vector<Relation> & partials );
+    bool     tryDependency( const std::vector<size_t> & rows, mpz_t & p, mpz_t & q );
+
+    Mpz                   n_, kn_;
+    unsigned              multiplier_;
+    SiqsParams            params_;
+    size_t                half_;        // M, sieve interval is [ -M, M )
+    uint64_t              largeBound_;
+    unsigned              threshold_;
+    size_t                sieveStart_;  // first factor base index that is sieved
+    std::vector<uint32_t> primes_;      // primes_[0] = 0 for -1
+    std::vector<uint32_t> roots_;       // sqrt( kN ) mod p
+    std::vector<uint8_t>  logs_;
+    double                targetBits_;  // log2 of ideal A
+    size_t                qLow_, qHigh_, qCount_;
+
+    std::mutex                              mutex_;
+    std::atomic<bool>                       done_;
+    size_t                                  target_;
+    std::vector<Relation>                   relations_;
+    std::unordered_map<uint64_t, Relation>  partials_;
+    std::set<std::vector<uint32_t>>         usedA_;
+};
+
+Siqs::Siqs( const mpz_t & n ) : multiplier_( 1 ), half_( 0 ), largeBound_( 0 ), threshold_( 0 ), sieveStart_( 1 ),
+                                targetBits_( 0 ), qLow_( 0 ), qHigh_( 0 ), qCount_( 0 ), done_( false ), target_( 0 ) {
+    mpz_set( n_.v, n );
+    size_t bits = mpz_sizeinbase( n, 2 );
+    params_     = PARAMS[sizeof( PARAMS ) / sizeof( PARAMS[0] ) - 1];
+    for ( const SiqsParams & params : PARAMS ) {
+        if ( bits <= params.bits ) {
+            params_ = params;
+            break;
+        }
+    }
+}
+
+/*
+ * Knuth-Schroeppel function, prefers k for which kN is a quadratic residue of many small primes
+ */
+void Siqs::selectMultiplier() {
+    std::vector<uint32_t> small = oddPrimes( 2000 );
+    double                best  = -1e9;
+    for ( unsigned k : MULTIPLIERS ) {
+        mpz_mul_ui( kn_.v, n_.v, k );
+        double   score = -0.5 * std::log( k );
+        unsigned mod8  = mpz_fdiv_ui( kn_.v, 8 );
+        score += mod8 == 1 ? 2 * std::log( 2 ) : mod8 == 5 ? std::log( 2 ) : mod8 % 4 == 3 ? 0.5 * std::log( 2 ) : 0;
+        for ( uint32_t p : small ) {
+            uint32_t residue = mpz_fdiv_ui( kn_.v, p );
+            if ( k % p == 0 ) {
+                score += std::log( p ) / p;
+            }
+            else if ( residue && powMod( residue, ( p - 1 ) / 2, p ) == 1 ) {
+                score += 2 * std::log( p ) / ( p - 1 );
+            }
+        }
+        if ( score > best ) {
+            best        = score;
+            multiplier_ = k;
+        }
+    }
+    mpz_mul_ui( kn_.v, n_.v, multiplier_ );
+}
+
+uint32_t Siqs::prepare() {
+    selectMultiplier();
+
+    primes_.assign( 1, 0 );
+    roots_.assign( 1, 0 );
+    primes_.push_back( 2 );
+    roots_.push_back( mpz_odd_p( kn_.v ) );
+    for ( uint32_t limit = 1 << 16; primes_.size() < params_.primes; limit *= 2 ) {
+        primes_.resize( 2 );
+        roots_.resize( 2 );
+        for ( uint32_t p : oddPrimes( limit ) ) {
+            uint32_t residue = mpz_fdiv_ui( kn_.v, p );
+            if ( residue == 0 && multiplier_ % p != 0 ) {
+                return p;
+            }
+            if ( residue == 0 || powMod( residue, ( p - 1 ) / 2, p ) == 1 ) {
+                primes_.push_back( p );
+                roots_.push_back( sqrtMod( residue, p ) );
+                if ( primes_.size() == params_.primes ) {
+                    break;
+                }
+            }
+        }
+    }
+
+    double smallBits = 0;
+    for ( size_t i = 1; i < primes_.size(); i++ ) {
+        if ( primes_[i] < SIQS_SMALL_PRIME ) {
+            sieveStart_ = i + 1;
+            smallBits  += ( primes_[i] == 2 ? 1.0 : 2.0 ) * std::log2( primes_[i] ) / ( primes_[i] - 1 );
+        }
+    }
+
+    half_       = params_.blocks * BLOCK_SIZE;
+    largeBound_ = static_cast<uint64_t>( primes_.back() ) * params_.largeMultiplier;
+    double kBits   = mpz_sizeinbase( kn_.v, 2 );
+    double maxBits = kBits / 2 + std::log2( half_ ) - 0.5;
+    double threshold = std::max( 8.0, maxBits - std::log2( largeBound_ ) - smallBits - THRESHOLD_SLACK );
+    double scale     = std::min( 1.0, MAX_THRESHOLD / threshold );
+    threshold_  = static_cast<unsigned>( threshold * scale );
+    targetBits_ = ( kBits + 1 ) / 2 - std::log2( half_ );
+
+    logs_.resize( primes_.size() );
+    for ( size_t i = 1; i < primes_.size(); i++ ) {
+        logs_[i] = static_cast<uint8_t>( std::lround( std::log2( primes_[i] ) * scale ) );
+    }
+
+    // A is product of qCount_ primes of about the same size taken from [ qLow_, qHigh_ )
+    double middle = std::log2( primes_[std::max( sieveStart_, primes_.size() / 3 )] );
+    qCount_       = std::max<size_t>( 1, std::lround( targetBits_ / middle ) );
+    double ideal  = targetBits_ / qCount_;
+    qLow_  = sieveStart_;
+    qHigh_ = primes_.size();
+    while ( qLow_ < qHigh_ && std::log2( primes_[qLow_] ) < ideal - 0.6 ) {
+        qLow_++;
+    }
+    while ( qHigh_ > qLow_ && std::log2( primes_[qHigh_ - 1] ) > ideal + 0.6 ) {
+        qHigh_--;
+    }
+    while ( qHigh_ - qLow_ < 4 * qCount_ + 8 && ( qLow_ > sieveStart_ || qHigh_ < primes_.size() ) ) {
+        qLow_  = qLow_ > sieveStart_ ? qLow_ - 1 : qLow_;
+        qHigh_ = qHigh_ < primes_.size() ? qHigh_ + 1 : qHigh_;
+    }
+    return 0;
+}
+
+/*
+ * Picks qCount_ - 1 random primes and the one that brings product closest to ideal A
+ */
+bool Siqs::chooseA( std::mt19937_64 & random, std::vector<uint32_t> & chosen, mpz_t & a ) {
+    chosen.clear();
+    mpz_set_ui( a, 1 );
+    for ( size_t attempts = 0; chosen.size() + 1 < qCount_ && attempts < 1000; attempts++ ) {
+        uint32_t index = qLow_ + random() % ( qHigh_ - qLow_ );
+        if ( roots_[index] == 0 || std::find( chosen.begin(), chosen.end(), index ) != chosen.end() ) {
+            continue;
+        }
+        chosen.push_back( index );
+        mpz_mul_ui( a, a, primes_[index] );
+    }
+    if ( chosen.size() + 1 < qCount_ ) {
+        return false;
+    }
+
+    double   rest  = std::exp2( targetBits_ - std::log2( mpz_get_d( a ) ) );
+    uint32_t best  = 0;
+    double   error = 1e300;
+    size_t   start = std::lower_bound( primes_.begin() + sieveStart_, primes_.end(), static_cast<uint32_t>( std::min( rest, 4e9 ) ) ) - primes_.begin();
+    for ( size_t i = start > sieveStart_ + 16 ? start - 16 : sieveStart_; i < primes_.size() && i < start + 16; i++ ) {
+        double distance = std::fabs( std::log( primes_[i] / rest ) );
+        if ( roots_[i] && distance < error && std::find( chosen.begin(), chosen.end(), i ) == chosen.end() ) {
+            best  = i;
+            error = distance;
+        }
+    }
+    if ( best == 0 ) {
+        return false;
+    }
+    chosen.push_back( best );
+    mpz_mul_ui( a, a, primes_[best] );
+    std::sort( chosen.begin(), chosen.end() );
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return usedA_.insert( chosen ).second;
+}
+
+/*
+ * Moves sieved relations to shared store, partial relations with the same large prime are joined
+ */
+void Siqs::store( std::vector<Relation> & relations, std::vector<Relation> & partials ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    for ( Relation & relation : relations ) {
+        relations_.push_back( relation );
+    }
+    for ( Relation & relation : partials ) {
+        auto found = partials_.find( relation.large );
+        if ( found == partials_.end() ) {
+            partials_.insert( std::make_pair( relation.large, relation ) );
+            continue;
+        }
+        const Relation & other = found->second;
+        if ( mpz_cmp( other.y.v, relation.y.v ) == 0 ) {
+            continue;
+        }
+        Relation joined;
+        mpz_mul( joined.y.v, other.y.v, relation.y.v );
+        mpz_mod( joined.y.v, joined.y.v, n_.v );
+        joined.factors = other.factors;
+        joined.factors.insert( joined.factors.end(), relation.factors.begin(), relation.factors.end() );
+        joined.large = relation.large;
+        relations_.push_back( joined );
+        STAT_INC( STAT_SIQS_JOINED );
+    }
+    STAT_ADD( STAT_SIQS_RELATIONS, relations.size() );
+    STAT_ADD( STAT_SIQS_PARTIALS, partials.size() );
+    relations.clear();
+    partials.clear();
+    if ( relations_.size() >= target_ ) {
+        done_ = true;
+    }
+}
+
+/*
+ * Sieves polynomials of A chosen by this thread until enough relations are stored.
+ * Primes below LARGE_SIEVE_PRIME are sieved block by block, larger ones would
+ * pay their loop overhead in every block for a few hits, so they go over the
+ * whole interval first
+ */
+void Siqs::sieveWorker( unsigned id ) {
+    const size_t count = primes_.size(), interval = 2 * half_;
+    std::mt19937_64 random( 0x5eed + id * 7919 + mpz_fdiv_ui( n_.v, 1000003 ) );
+
+    // k-th sieved prime of current A is factor base entry index[k]
+    std::vector<uint32_t>              chosen, unsieved, index, prime, halfMod, soln1, soln2, start1, start2, next1, next2;
+    std::vector<uint8_t>               logs, sieve( interval );
+    std::vector<std::vector<uint32_t>> bainv2;
+    std::vector<Relation>              relations, partials;
+    MpzList                            bs;
+
+    mpz_t a, b, c, b2, t, g;
+    mpz_inits( a, b, c, b2, t, g, nullptr );
+
+    auto divide = [&]( uint32_t i, Relation & relation ) {
+        while ( mpz_divisible_ui_p( g, primes_[i] ) ) {
+            mpz_divexact_ui( g, g, primes_[i] );
+            relation.factors.push_back( i );
+        }
+    };
+
+    for ( size_t failed = 0; !done_; ) {
+        if ( !chooseA( random, chosen, a ) ) {
+            if ( ++failed == MAX_FAILED_A ) {
+                done_ = true;
+            }
+            continue;
+        }
+        failed = 0;
+
+        size_t s = chosen.size();
+        bs.assign( s, Mpz() );
+        mpz_set_ui( b, 0 );
+        for ( size_t l = 0; l < s; l++ ) {
+            uint32_t q = primes_[chosen[l]];
+            mpz_divexact_ui( t, a, q );
+            uint64_t gamma = static_cast<uint64_t>( roots_[chosen[l]] ) * inverseMod( mpz_fdiv_ui( t, q ), q ) % q;
+            mpz_mul_ui( bs[l].v, t, gamma > q / 2 ? q - gamma : gamma );
+            mpz_add( b, b, bs[l].v );
+        }
+
+        unsieved.clear();
+        index.clear();
+        for ( uint32_t i = 1; i < count; i++ ) {
+            bool skip = i < sieveStart_ || roots_[i] == 0 || std::binary_search( chosen.begin(), chosen.end(), i );
+            ( skip ? unsieved : index ).push_back( i );
+        }
+        size_t sieved = index.size();
+        for ( std::vector<uint32_t> * v : { &prime, &halfMod, &soln1, &soln2, &start1, &start2, &next1, &next2 } ) {
+            v->resize( sieved );
+        }
+        logs.resize( sieved );
+        bainv2.assign( s, std::vector<uint32_t>( sieved ) );
+        for ( size_t k = 0; k < sieved; k++ ) {
+            uint32_t p    = primes_[index[k]];
+            uint64_t ainv = inverseMod( mpz_fdiv_ui( a, p ), p ), bmod = mpz_fdiv_ui( b, p ), root = roots_[index[k]];
+            prime[k]   = p;
+            logs[k]    = logs_[index[k]];
+            halfMod[k] = half_ % p;
+            soln1[k]   = ainv * ( ( root + p - bmod ) % p ) % p;
+            soln2[k]   = ainv * ( ( 2 * p - root - bmod ) % p ) % p;
+            for ( size_t l = 0; l < s; l++ ) {
+                bainv2[l][k] = 2 * ( mpz_fdiv_ui( bs[l].v, p ) * ainv % p ) % p;
+            }
+        }
+        size_t medium = std::lower_bound( prime.begin(), prime.end(), LARGE_SIEVE_PRIME ) - prime.begin();
+
+        for ( size_t poly = 0; poly < ( size_t( 1 ) << ( s - 1 ) ) && !done_; poly++ ) {
+            if ( poly > 0 ) {
+                // Gray code step, b moves by 2 B_v and roots by 2 B_v / A
+                size_t v    = __builtin_ctzl( poly );
+                bool   plus = ( ( ( poly >> v ) + 1 ) / 2 ) % 2 == 0;
+                if ( plus ) {
+                    mpz_addmul_ui( b, bs[v].v, 2 );
+                }
+                else {
+                    mpz_submul_ui( b, bs[v].v, 2 );
+                }
+                const uint32_t * delta = bainv2[v].data();
+                for ( size_t k = 0; k < sieved; k++ ) {
+                    uint32_t p = prime[k], d = plus ? p - delta[k] : delta[k];
+                    soln1[k] = soln1[k] + d >= p ? soln1[k] + d - p : soln1[k] + d;
+                    soln2[k] = soln2[k] + d >= p ? soln2[k] + d - p : soln2[k] + d;
+                }
+            }
+            STAT_INC( STAT_SIQS_POLYNOMIALS );
+            mpz_mul( c, b, b );
+            mpz_sub( c, c, kn_.v );
+            mpz_divexact( c, c, a );
+            mpz_mul_2exp( b2, b, 1 );
+
+            // Roots in sieve coordinates j = x + M
+            for ( size_t k = 0; k < sieved; k++ ) {
+                uint32_t p = prime[k];
+                start1[k] = next1[k] = soln1[k] + halfMod[k] >= p ? soln1[k] + halfMod[k] - p : soln1[k] + halfMod[k];
+                start2[k] = next2[k] = soln2[k] + halfMod[k] >= p ? soln2[k] + halfMod[k] - p : soln2[k] + halfMod[k];
+            }
+            std::memset( sieve.data(), 128 - threshold_, interval );
+            for ( size_t k = medium; k < sieved; k++ ) {
+                uint32_t p = prime[k];
+                uint8_t  lg = logs[k];
+                for ( size_t j = start1[k]; j < interval; j += p ) {
+                    sieve[j] += lg;
+                }
+                for ( size_t j = start2[k]; j < interval; j += p ) {
+                    sieve[j] += lg;
+                }
+            }
+
+            for ( size_t block = 0; block < interval; block += BLOCK_SIZE ) {
+                uint8_t * segment = sieve.data() + block;
+                for ( size_t k = 0; k < medium; k++ ) {
+                    uint32_t p = prime[k], j1 = std::min( next1[k], next2[k] ), j2 = std::max( next1[k], next2[k] );
+                    uint8_t  lg = logs[k];
+                    while ( j2 < BLOCK_SIZE ) {
+                        segment[j1] += lg;
+                        segment[j2] += lg;
+                        j1 += p;
+                        j2 += p;
+                    }
+                    if ( j1 < BLOCK_SIZE ) {
+                        segment[j1] += lg;
+                        j1 += p;
+                    }
+                    next1[k] = j1 - BLOCK_SIZE;
+                    next2[k] = j2 - BLOCK_SIZE;
+                }
+                for ( size_t offset = 0; offset < BLOCK_SIZE; offset += 8 ) {
+                    uint64_t word;
+                    std::memcpy( &word, segment + offset, 8 );
+                    if ( ( word & 0x8080808080808080ULL ) == 0 ) {
+                        continue;
+                    }
+                    for ( size_t hit = offset; hit < offset + 8; hit++ ) {
+                        if ( !( segment[hit] & 0x80 ) ) {
+                            continue;
+                        }
+                        size_t j = block + hit;
+                        long   x = static_cast<long>( j ) - static_cast<long>( half_ );
+                        STAT_INC( STAT_SIQS_CANDIDATES );
+
+                        // g( x ) = ( A x + 2 b ) x + c
+                        mpz_mul_si( g, a, x );
+                        mpz_add( g, g, b2 );
+                        mpz_mul_si( g, g, x );
+                        mpz_add( g, g, c );
+                        Relation relation;
+                        if ( mpz_sgn( g ) < 0 ) {
+                            relation.factors.push_back( 0 );
+                            mpz_neg( g, g );
+                        }
+                        for ( uint32_t i : unsieved ) {
+                            divide( i, relation );
+                        }
+                        for ( size_t k = 0; k < sieved; k++ ) {
+                            uint32_t r = j % prime[k];
+                            if ( r == start1[k] || r == start2[k] ) {
+                                divide( index[k], relation );
+                            }
+                        }
+                        if ( mpz_cmp_ui( g, 1 ) != 0 && ( !mpz_fits_ulong_p( g ) || mpz_get_ui( g ) >= largeBound_ ) ) {
+                            continue;
+                        }
+                        relation.factors.insert( relation.factors.end(), chosen.begin(), chosen.end() );
+                        relation.large = mpz_get_ui( g );
+                        mpz_mul_si( relation.y.v, a, x );
+                        mpz_add( relation.y.v, relation.y.v, b );
+                        ( relation.large == 1 ? relations : partials ).push_back( relation );
+                    }
+                }
+            }
+        }
+        store( relations, partials );
+    }
+    mpz_clears( a, b, c, b2, t, g, nullptr );
+}
+
+void Siqs::collect( size_t target, size_t threads ) {
+    target_ = target;
+    done_   = relations_.size() >= target_;
+    std::vector<std::thread> workers;
+    for ( size_t id = 1; id < threads; id++ ) {
+        workers.emplace_back( &Siqs::sieveWorker, this, id );
+    }
+    sieveWorker( 0 );
+    for ( std::thread & worker : workers ) {
+        worker.join();
+    }
+}
+
+bool Siqs::tryDependency( const std::vector<size_t> & rows, mpz_t & p, mpz_t & q ) {
+    std::vector<uint32_t> exponents( primes_.size(), 0 );
+    mpz_t x, y, t;
+    mpz_inits( x, y, t, nullptr );
+    mpz_set_ui( x, 1 );
+    mpz_set_ui( y, 1 );
+    for ( size_t row : rows ) {
+        const Relation & relation = relations_[row];
+        mpz_mul( x, x, relation.y.v );
+        mpz_mod( x, x, n_.v );
+        mpz_mul_ui( y, y, relation.large );
+        mpz_mod( y, y, n_.v );
+        for ( uint32_t index : relation.factors ) {
+            exponents[index]++;
+        }
+    }
+    for ( size_t i = 1; i < primes_.size(); i++ ) {
+        if ( exponents[i] ) {
+            mpz_set_ui( t, primes_[i] );
+            mpz_powm_ui( t, t, exponents[i] / 2, n_.v );
+            mpz_mul( y, y, t );
+            mpz_mod( y, y, n_.v );
+        }
+    }
+    mpz_sub( t, x, y );
+    mpz_gcd( p, t, n_.v );
+    bool found = mpz_cmp_ui( p, 1 ) > 0 && mpz_cmp( p, n_.v ) < 0;
+    if ( found ) {
+        mpz_divexact( q, n_.v, p );
+    }
+    mpz_clears( x, y, t, nullptr );
+    return found;
+}
+
+bool Siqs::solve( mpz_t & p, mpz_t & q ) {
+    const size_t columns = primes_.size();
+    std::vector<std::vector<uint32_t>> odd( relations_.size() );
+    std::vector<uint32_t>              weight( columns, 0 );
+    for ( size_t r = 0; r < relations_.size(); r++ ) {
+        std::vector<uint32_t> factors = relations_[r].factors;
+        std::sort( factors.begin(), factors.end() );
+        for ( size_t i = 0; i < factors.size(); ) {
+            size_t j = i;
+            while ( j < factors.size() && factors[j] == factors[i] ) {
+                j++;
+            }
+            if ( ( j - i ) % 2 ) {
+                odd[r].push_back( factors[i] );
+                weight[factors[i]]++;
+            }
+            i = j;
+        }
+    }
+
+    // Singleton filtering, relation with the only odd occurrence of a prime is never part of dependency
+    std::vector<bool> active( relations_.size(), true );
+    for ( bool changed = true; changed; ) {
+        changed = false;
+        for ( size_t r = 0; r < relations_.size(); r++ ) {
+            if ( !active[r] ) {
+                continue;
+            }
+            for ( uint32_t column : odd[r] ) {
+                if ( weight[column] == 1 ) {
+                    active[r] = false;
+                    changed   = true;
+                    for ( uint32_t other : odd[r] ) {
+                        weight[other]--;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> compact( columns, 0 );
+    size_t                used = 0;
+    for ( size_t c = 0; c < columns; c++ ) {
+        compact[c] = weight[c] ? used++ : UINT32_MAX;
+    }
+    std::vector<size_t> rows;
+    for ( size_t r = 0; r < relations_.size(); r++ ) {
+        if ( active[r] ) {
+            rows.push_back( r );
+        }
+    }
+    if ( rows.size() > used + EXTRA_RELATIONS ) {
+        rows.resize( used + EXTRA_RELATIONS );
+    }
+
+    // Packed rows [ columns | identity ], forward elimination leaves dependencies in rows past rank
+    const size_t columnWords = ( used + 63 ) / 64, width = columnWords + ( rows.size() + 63 ) / 64;
+    std::vector<uint64_t> matrix( rows.size() * width, 0 );
+    for ( size_t r = 0; r < rows.size(); r++ ) {
+        uint64_t * row = matrix.data() + r * width;
+        for ( uint32_t column : odd[rows[r]] ) {
+            if ( compact[column] != UINT32_MAX ) {
+                row[compact[column] / 64] |= 1ULL << ( compact[column] % 64 );
+            }
+        }
+        row[columnWords + r / 64] |= 1ULL << ( r % 64 );
+    }
+
+    size_t rank = 0;
+    for ( size_t c = 0; c < used && rank < rows.size(); c++ ) {
+        size_t word = c / 64;
+        uint64_t bit = 1ULL << ( c % 64 );
+        size_t pivot = rank;
+        while ( pivot < rows.size() && !( matrix[pivot * width + word] & bit ) ) {
+            pivot++;
+        }
+        if ( pivot == rows.size() ) {
+            continue;
+        }
+        uint64_t * top = matrix.data() + rank * width;
+        if ( pivot != rank ) {
+            std::swap_ranges( top, top + width, matrix.data() + pivot * width );
+        }
+        for ( size_t r = rank + 1; r < rows.size(); r++ ) {
+            uint64_t * row = matrix.data() + r * width;
+            if ( row[word] & bit ) {
+                for ( size_t w = word; w < width; w++ ) {
+                    row[w] ^= top[w];
+                }
+            }
+        }
+        rank++;
+    }
+
+    for ( size_t r = rank; r < rows.size(); r++ ) {
+        const uint64_t *    row = matrix.data() + r * width + columnWords;
+        std::vector<size_t> dependency;
+        for ( size_t i = 0; i < rows.size(); i++ ) {
+            if ( row[i / 64] & ( 1ULL << ( i % 64 ) ) ) {
+                dependency.push_back( rows[i] );
+            }
+        }
+        if ( !dependency.empty() && tryDependency( dependency, p, q ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ReturnValues factorSiqs( mpz_t & p, mpz_t & q, const mpz_t & n, size_t threads ) {
+    STAT_TIME( TIMER_SIQS );
+    if ( mpz_cmp_ui( n, 1 ) <= 0 || mpz_perfect_power_p( n ) || mpz_probab_prime_p( n, 30 ) ) {
+        return INVALID_PARAM_N;
+    }
+    if ( mpz_even_p( n ) ) {
+        mpz_set_ui( p, 2 );
+        mpz_divexact_ui( q, n, 2 );
+        return SUCCESS;
+    }
+    if ( threads == 0 ) {
+        threads = std::max( 1u, std::thread::hardware_concurrency() );
+    }
+
+    Siqs     siqs( n );
+    uint32_t divisor = siqs.prepare();
+    if ( divisor ) {
+        mpz_set_ui( p, divisor );
+        mpz_divexact_ui( q, n, divisor );
+        return SUCCESS;
+    }
+    size_t target = siqs.primes() + EXTRA_RELATIONS;
+    for ( int attempt = 0; attempt < SOLVE_ATTEMPTS; attempt++ ) {
+        siqs.collect( target, threads );
+        if ( siqs.solve( p, q ) ) {
+            if ( mpz_cmp( p, q ) > 0 ) {
+                mpz_swap( p, q );
+            }
+            return SUCCESS;
+        }
+        target += EXTRA_RELATIONS;
+    }
+    return INVALID_PARAM_N;
+}
+
+size_t siqsRelations( const mpz_t & n, size_t target, size_t threads ) {
+    if ( threads == 0 ) {
+        threads = std::max( 1u, std::thread::hardware_concurrency() );
+    }
+    Siqs siqs( n );
+    if ( siqs.prepare() ) {
+        return 0;
+    }
+    siqs.collect( target, threads );
+    return siqs.relations();
+}
@@ -0,0 +1,44 @@
+#ifndef SIQS_H
+#define SIQS_H
+
+#include <cstddef>
+#include <gmp.h>
+#include "kry.h"
+
+/*
+ * Self-initializing quadratic sieve for balanced moduli of roughly 40 to 100 digits.
+ *
+ * Relations are collected by independent threads, each sieving its own A
+ * polynomials over L1 sized blocks. Primes below SIQS_SMALL_PRIME are not sieved
+ * (small prime variation) and relations with one large prime are paired by that
+ * prime. Dependencies are found by singleton filtering followed by Gaussian
+ * elimination over packed GF(2) rows.
+ */
+const unsigned SIQS_SMALL_PRIME = 64;
+
+/*
+ * kry -b sieves moduli above this size, rho on the word sized engine needs
+ * about 2^( bits / 4 ) steps and falls behind from here on
+ */
+const size_t SIQS_MIN_BITS = 80;
+
+/*
+ * About 100 digits, larger moduli would sieve for days, kry -b hands them to
+ * rho, which still finds an unbalanced factor, distributed with workers
+ */
+const size_t SIQS_MAX_BITS = 332;
+
+/*
+ * Splits n into p * q, threads = 0 uses every CPU. Returns INVALID_PARAM_N when
+ * n is prime, a perfect power or the sieve gives up
+ */
+ReturnValues factorSiqs( mpz_t & p, mpz_t & q, const mpz_t & n, size_t threads = 0 );
+
+/*
+ * Sieves n until target full relations are collected and returns their number,
+ * 0 when a factor base prime divides n. Checks sieve yield on moduli too large
+ * to factor in a benchmark run
+ */
+size_t siqsRelations( const mpz_t & n, size_t target, size_t threads = 0 );
+
+#endif
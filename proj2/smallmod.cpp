@@ -0,0 +1,425 @@
+#include "smallmod.h"
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include "stats.h"
+
+typedef unsigned __int128 u128;
+
+static const unsigned SMALL_PRIMES[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+
+// Miller-Rabin with bases 2, 325, 9375, 28178, 450775, 9780504, 1795265022 is exact below 2^64
+static const uint64_t WORD_BASES[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+// Smallest strong pseudoprime to all of SMALL_PRIMES, 318665857834031151167461
+static const u128 SMALL_PRIMES_LIMIT = static_cast<u128>( 318665857834ULL ) * 1000000000000ULL + 31151167461ULL;
+
+// Products of differences multiplied in Brent's rho before one gcd
+static const size_t RHO_BATCH = 128;
+
+static u128 toWord( const mpz_t & n ) {
+    uint64_t words[2] = { 0, 0 };
+    mpz_export( words, nullptr, -1, sizeof( uint64_t ), 0, 0, n );
+    return ( static_cast<u128>( words[1] ) << 64 ) | words[0];
+}
+
+static void fromWord( mpz_t & result, u128 value ) {
+    uint64_t words[2] = { static_cast<uint64_t>( value ), static_cast<uint64_t>( value >> 64 ) };
+    mpz_import( result, 2, -1, sizeof( uint64_t ), 0, 0, words );
+}
+
+static int trailingZeros( uint64_t n ) {
+    return __builtin_ctzll( n );
+}
+
+static int trailingZeros( u128 n ) {
+    uint64_t low = n;
+    return low ? __builtin_ctzll( low ) : 64 + __builtin_ctzll( static_cast<uint64_t>( n >> 64 ) );
+}
+
+/*
+ * Binary gcd on machine words
+ */
+template<class Word>
+static Word gcdWord( Word a, Word b ) {
+    if ( a == 0 || b == 0 ) {
+        return a | b;
+    }
+    int shift = trailingZeros( a | b );
+    a >>= trailingZeros( a );
+    while ( b ) {
+        b >>= trailingZeros( b );
+        if ( a > b ) {
+            std::swap( a, b );
+        }
+        b -= a;
+    }
+    return a << shift;
+}
+
+/*
+ * Jacobi symbol ( a / n ) for odd n
+ */
+template<class Word>
+static int jacobi( Word a, Word n ) {
+    int result = 1;
+    a %= n;
+    while ( a ) {
+        while ( ( a & 1 ) == 0 ) {
+            a >>= 1;
+            if ( ( n & 7 ) == 3 || ( n & 7 ) == 5 ) {
+                result = -result;
+            }
+        }
+        std::swap( a, n );
+        if ( ( a & 3 ) == 3 && ( n & 3 ) == 3 ) {
+            result = -result;
+        }
+        a %= n;
+    }
+    return n == 1 ? result : 0;
+}
+
+static bool isSquare( u128 n ) {
+    u128 root = static_cast<u128>( std::sqrt( static_cast<long double>( n ) ) );
+    const u128 maximum = ~static_cast<uint64_t>( 0 );
+    root = root > maximum ? maximum : root;
+    while ( root * root > n ) {
+        root--;
+    }
+    while ( root < maximum && ( root + 1 ) * ( root + 1 ) <= n ) {
+        root++;
+    }
+    return root * root == n;
+}
+
+/*
+ * Montgomery arithmetic modulo odd n < 2^64 with R = 2^64
+ */
+class Montgomery64 {
+public:
+    typedef uint64_t Word;
+
+    explicit Montgomery64( uint64_t n ) : n_( n ), inverse_( n ) {
+        for ( int i = 0; i < 5; i++ ) {
+            inverse_ *= 2 - n * inverse_;
+        }
+        one_ = -n % n;
+        r2_  = static_cast<u128>( one_ ) * one_ % n;
+    }
+
+    uint64_t modulus() const { return n_; }
+    uint64_t one()     const { return one_; }
+
+    uint64_t to( uint64_t a )   const { return mul( a % n_, r2_ ); }
+    uint64_t from( uint64_t a ) const { return reduce( 0, a ); }
+
+    uint64_t mul( uint64_t a, uint64_t b ) const {
+        u128 product = static_cast<u128>( a ) * b;
+        return reduce( product >> 64, product );
+    }
+
+    uint64_t add( uint64_t a, uint64_t b ) const { return a >= n_ - b ? a - ( n_ - b ) : a + b; }
+    uint64_t sub( uint64_t a, uint64_t b ) const { return a >= b ? a - b : a + ( n_ - b ); }
+
+private:
+    uint64_t reduce( uint64_t high, uint64_t low ) const {
+        uint64_t m = ( static_cast<u128>( low * inverse_ ) * n_ ) >> 64;
+        return high >= m ? high - m : high + ( n_ - m );
+    }
+
+    uint64_t n_, inverse_, one_, r2_;
+};
+
+/*
+ * Montgomery arithmetic modulo odd n < 2^128 with R = 2^128, products are
+ * assembled from four 64 x 64 bit multiplications
+ */
+class Montgomery128 {
+public:
+    typedef u128 Word;
+
+    explicit Montgomery128( u128 n ) : n_( n ), inverse_( n ) {
+        for ( int i = 0; i < 6; i++ ) {
+            inverse_ *= 2 - n * inverse_;
+        }
+        one_ = -n % n;
+        r2_  = one_;
+        for ( int i = 0; i < 128; i++ ) {
+            r2_ = add( r2_, r2_ );
+        }
+    }
+
+    u128 modulus() const { return n_; }
+    u128 one()     const { return one_; }
+
+    u128 to( u128 a )   const { return mul( a % n_, r2_ ); }
+    u128 from( u128 a ) const { return reduce( 0, a ); }
+
+    u128 mul( u128 a, u128 b ) const {
+        u128 high, low;
+        multiply( a, b, high, low );
+        return reduce( high, low );
+    }
+
+    u128 add( u128 a, u128 b ) const { return a >= n_ - b ? a - ( n_ - b ) : a + b; }
+    u128 sub( u128 a, u128 b ) const { return a >= b ? a - b : a + ( n_ - b ); }
+
+private:
+    static void multiply( u128 a, u128 b, u128 & high, u128 & low ) {
+        uint64_t a0 = a, a1 = a >> 64, b0 = b, b1 = b >> 64;
+        u128 p00 = static_cast<u128>( a0 ) * b0, p01 = static_cast<u128>( a0 ) * b1;
+        u128 p10 = static_cast<u128>( a1 ) * b0, p11 = static_cast<u128>( a1 ) * b1;
+        u128 middle = ( p00 >> 64 ) + static_cast<uint64_t>( p01 ) + static_cast<uint64_t>( p10 );
+        low  = ( middle << 64 ) | static_cast<uint64_t>( p00 );
+        high = p11 + ( p01 >> 64 ) + ( p10 >> 64 ) + ( middle >> 64 );
+    }
+
+    u128 reduce( u128 high, u128 low ) const {
+        u128 m, unused;
+        multiply( low * inverse_, n_, m, unused );
+        return high >= m ? high - m : high + ( n_ - m );
+    }
+
+    u128 n_, inverse_, one_, r2_;
+};
+
+/*
+ * Left to right exponentiation of base in Montgomery form, bit( i ) returns i-th exponent bit
+ */
+template<class M, class Bits>
+static typename M::Word power( const M & m, typename M::Word base, size_t bits, Bits bit ) {
+    typename M::Word result = m.one();
+    while ( bits-- > 0 ) {
+        result = m.mul( result, result );
+        if ( bit( bits ) ) {
+            result = m.mul( result, base );
+        }
+    }
+    return result;
+}
+
+template<class M, class Word>
+static typename M::Word powerWord( const M & m, typename M::Word base, Word exp ) {
+    size_t bits = 0;
+    for ( Word e = exp; e; e >>= 1 ) {
+        bits++;
+    }
+    return power( m, base, bits, [exp]( size_t i ) { return ( exp >> i ) & 1; } );
+}
+
+/*
+ * Strong probable prime test of odd n > base to given base
+ */
+template<class M>
+static bool strongProbablePrime( const M & m, typename M::Word base ) {
+    typedef typename M::Word Word;
+    Word n = m.modulus(), d = n - 1;
+    int  s = trailingZeros( d );
+    d >>= s;
+
+    Word one = m.one(), minusOne = n - one;
+    Word x   = powerWord( m, m.to( base ), d );
+    if ( x == one || x == minusOne ) {
+        return true;
+    }
+    while ( --s > 0 ) {
+        x = m.mul( x, x );
+        if ( x == minusOne ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Strong Lucas probable prime test with Selfridge parameters P = 1, Q = ( 1 - D ) / 4
+ */
+template<class M>
+static bool strongLucasProbablePrime( const M & m ) {
+    typedef typename M::Word Word;
+    Word n = m.modulus();
+    if ( isSquare( n ) ) {
+        return false;
+    }
+
+    long long d = 5;
+    Word      dn;
+    while ( true ) {
+        dn = d > 0 ? static_cast<Word>( d ) % n : ( n - static_cast<Word>( -d ) % n ) % n;
+        int symbol = jacobi( dn, n );
+        if ( symbol == -1 ) {
+            break;
+        }
+        if ( symbol == 0 ) {
+            return false;
+        }
+        d = d > 0 ? -d - 2 : -d + 2;
+    }
+    long long q  = ( 1 - d ) / 4;
+    Word      qn = q >= 0 ? static_cast<Word>( q ) % n : ( n - static_cast<Word>( -q ) % n ) % n;
+
+    Word k = n + 1;
+    int  s = trailingZeros( k );
+    k >>= s;
+
+    Word mD = m.to( dn ), mQ = m.to( qn ), half = ( n >> 1 ) + 1;
+    Word u = m.one(), v = m.one(), qk = mQ;
+    auto halve = [half]( Word x ) { return ( x >> 1 ) + ( x & 1 ? half : 0 ); };
+
+    int top = 0;
+    for ( Word e = k; e > 1; e >>= 1 ) {
+        top++;
+    }
+    for ( int bit = top - 1; bit >= 0; bit-- ) {
+        u  = m.mul( u, v );
+        v  = m.sub( m.mul( v, v ), m.add( qk, qk ) );
+        qk = m.mul( qk, qk );
+        if ( ( k >> bit ) & 1 ) {
+            Word next = halve( m.add( u, v ) );
+            v  = halve( m.add( m.mul( mD, u ), v ) );
+            u  = next;
+            qk = m.mul( qk, mQ );
+        }
+    }
+
+    if ( u == 0 || v == 0 ) {
+        return true;
+    }
+    while ( --s > 0 ) {
+        v  = m.sub( m.mul( v, v ), m.add( qk, qk ) );
+        qk = m.mul( qk, qk );
+        if ( v == 0 ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Brent's rho with f( x ) = x^2 + c, returns factor of n, n itself on failure
+ */
+template<class M>
+static typename M::Word brent( const M & m, typename M::Word c ) {
+    typedef typename M::Word Word;
+    Word n = m.modulus(), mc = m.to( c ), y = m.to( 2 ), q = m.one(), g = 1, x = y, ys = y;
+    auto step = [&m, mc]( Word a ) { return m.add( m.mul( a, a ), mc ); };
+    auto diff = []( Word a, Word b ) { return a > b ? a - b : b - a; };
+
+    for ( size_t r = 1; g == 1; r <<= 1 ) {
+        x = y;
+        for ( size_t i = 0; i < r; i++ ) {
+            y = step( y );
+        }
+        for ( size_t k = 0; k < r && g == 1; k += RHO_BATCH ) {
+            ys = y;
+            for ( size_t i = 0; i < RHO_BATCH && i < r - k; i++ ) {
+                y = step( y );
+                q = m.mul( q, diff( x, y ) );
+            }
+            STAT_ADD( STAT_POLLARD_ITERATIONS, r - k < RHO_BATCH ? r - k : RHO_BATCH );
+            g = gcdWord( q, n );
+        }
+    }
+    if ( g == n ) {
+        do {
+            ys = step( ys );
+            g  = gcdWord( diff( x, ys ), n );
+        } while ( g == 1 );
+    }
+    return g;
+}
+
+bool fitsSmall( const mpz_t & n ) {
+    return mpz_sgn( n ) >= 0 && mpz_sizeinbase( n, 2 ) <= SMALL_BITS;
+}
+
+bool smallModulus( const mpz_t & modulo ) {
+    return mpz_odd_p( modulo ) && mpz_cmp_ui( modulo, 1 ) > 0 && mpz_sizeinbase( modulo, 2 ) <= SMALL_BITS;
+}
+
+/*
+ * num mod modulo as machine word, n is value of modulo
+ */
+static u128 residue( const mpz_t & num, const mpz_t & modulo, u128 n ) {
+    if ( fitsSmall( num ) ) {
+        return toWord( num ) % n;
+    }
+    mpz_t r;
+    mpz_init( r );
+    mpz_fdiv_r( r, num, modulo );
+    u128 value = toWord( r );
+    mpz_clear( r );
+    return value;
+}
+
+template<class M, class Bits>
+static u128 powmWord( const M & m, u128 base, size_t bits, Bits bit ) {
+    return base == 0 ? 0 : m.from( power( m, m.to( base ), bits, bit ) );
+}
+
+void powmSmall( mpz_t & result, const mpz_t & num, const mpz_t & exp, const mpz_t & modulo ) {
+    u128   n    = toWord( modulo ), base = residue( num, modulo, n );
+    size_t bits = mpz_sgn( exp ) ? mpz_sizeinbase( exp, 2 ) : 0;
+    auto   bit  = [&exp]( size_t i ) { return mpz_tstbit( exp, i ); };
+    fromWord( result, n >> 64 ? powmWord( Montgomery128( n ), base, bits, bit ) : powmWord( Montgomery64( n ), base, bits, bit ) );
+}
+
+void powmSmall( mpz_t & result, const mpz_t & num, unsigned long exp, const mpz_t & modulo ) {
+    u128   n    = toWord( modulo ), base = residue( num, modulo, n );
+    size_t bits = exp ? sizeof( exp ) * 8 - __builtin_clzl( exp ) : 0;
+    auto   bit  = [exp]( size_t i ) { return ( exp >> i ) & 1; };
+    fromWord( result, n >> 64 ? powmWord( Montgomery128( n ), base, bits, bit ) : powmWord( Montgomery64( n ), base, bits, bit ) );
+}
+
+bool isPrimeSmall( const mpz_t & n ) {
+    u128 value = toWord( n );
+    if ( value < 2 ) {
+        return false;
+    }
+    for ( unsigned p : SMALL_PRIMES ) {
+        if ( value % p == 0 ) {
+            return value == p;
+        }
+    }
+    if ( value < 37 * 37 ) {
+        return true;
+    }
+
+    if ( value >> 64 == 0 ) {
+        Montgomery64 m( value );
+        for ( uint64_t base : WORD_BASES ) {
+            if ( base % value != 0 && !strongProbablePrime( m, base % value ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+    Montgomery128 m( value );
+    for ( unsigned base : SMALL_PRIMES ) {
+        if ( !strongProbablePrime( m, base ) ) {
+            return false;
+        }
+    }
+    return value < SMALL_PRIMES_LIMIT || strongLucasProbablePrime( m );
+}
+
+void factorSmall( mpz_t & p, mpz_t & q, const mpz_t & n ) {
+    u128 value = toWord( n ), factor = value;
+    if ( value > 1 && !isPrimeSmall( n ) ) {
+        for ( unsigned prime : SMALL_PRIMES ) {
+            if ( value % prime == 0 ) {
+                factor = prime;
+                break;
+            }
+        }
+        for ( u128 c = 1; factor == value; c++ ) {
+            factor = value >> 64 ? brent( Montgomery128( value ), c ) : brent( Montgomery64( value ), c );
+            if ( factor == value ) {
+                STAT_INC( STAT_POLLARD_RESTARTS );
+            }
+        }
+    }
+    fromWord( p, factor );
+    fromWord( q, value > 1 ? value / factor : value );
+}
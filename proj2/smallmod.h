@@ -0,0 +1,40 @@
+#ifndef SMALLMOD_H
+#define SMALLMOD_H
+
+#include <gmp.h>
+
+/*
+ * Word sized engine for numbers below 2^128. Arithmetic runs in Montgomery form
+ * on uint64_t or unsigned __int128, so no mpz_t is allocated on the way. kry.cpp
+ * dispatches to it from powm, isPrime and unlimitedPower.
+ */
+const size_t SMALL_BITS = 128;
+
+/*
+ * Tests that 0 <= n < 2^128
+ */
+bool fitsSmall( const mpz_t & n );
+
+/*
+ * Tests that modulo is odd, greater than one and below 2^128
+ */
+bool smallModulus( const mpz_t & modulo );
+
+/*
+ * Computes num^exp mod modulo for modulo that passes smallModulus and exp >= 0
+ */
+void powmSmall( mpz_t & result, const mpz_t & num, const mpz_t & exp, const mpz_t & modulo );
+void powmSmall( mpz_t & result, const mpz_t & num, unsigned long exp, const mpz_t & modulo );
+
+/*
+ * Deterministic primality test for n that fits to small engine. Miller-Rabin with
+ * bases proven for n < 2^64 and n < 3.1 * 10^23, strong Lucas test on top above that (BPSW)
+ */
+bool isPrimeSmall( const mpz_t & n );
+
+/*
+ * Splits n into p * q with Brent's variant of Pollard rho, p = n and q = 1 for prime n
+ */
+void factorSmall( mpz_t & p, mpz_t & q, const mpz_t & n );
+
+#endif
@@ -0,0 +1,34 @@
+#include "stats.h"
+
+static const char * COUNTER_NAMES[STAT_COUNTERS] = {
+    "modexp_calls", "modexp_bits", "gcd_calls", "random_bytes",
+    "prime_candidates", "prime_rejected_exponent", "prime_rejected_duplicate", "prime_rejected_test",
+    "pollard_iterations", "pollard_restarts",
+    "siqs_polynomials", "siqs_candidates", "siqs_relations", "siqs_partials", "siqs_joined",
+    "dist_units", "dist_workers", "keygen_sieved", "pool_hits", "pool_misses"
+};
+
+static const char * TIMER_NAMES[STAT_TIMERS] = { "generate", "encrypt", "decrypt", "factor", "siqs" };
+
+#ifdef KRY_STATS
+std::atomic<uint64_t> statCounters[STAT_COUNTERS];
+std::atomic<uint64_t> statTimers[STAT_TIMERS];
+
+void printStats( std::ostream & out ) {
+    out << "{\"enabled\": true, \"counters\": {";
+    for ( int i = 0; i < STAT_COUNTERS; i++ ) {
+        out << ( i ? ", " : "" ) << '"' << COUNTER_NAMES[i] << "\": " << statCounters[i].load();
+    }
+    out << "}, \"timers_ns\": {";
+    for ( int i = 0; i < STAT_TIMERS; i++ ) {
+        out << ( i ? ", " : "" ) << '"' << TIMER_NAMES[i] << "\": " << statTimers[i].load();
+    }
+    out << "}}" << std::endl;
+}
+#else
+void printStats( std::ostream & out ) {
+    (void) COUNTER_NAMES;
+    (void) TIMER_NAMES;
+    out << "{\"enabled\": false}" << std::endl;
+}
+#endif
@@ -0,0 +1,58 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+#include <ostream>
+
+/*
+ * Hot path counters and timers. They are compiled in only with -DKRY_STATS
+ * ("make STATS=1"), otherwise every macro expands to nothing.
+ */
+enum StatCounter {
+    STAT_MODEXP_CALLS, STAT_MODEXP_BITS, STAT_GCD_CALLS, STAT_RANDOM_BYTES,
+    STAT_PRIME_CANDIDATES, STAT_PRIME_REJECTED_EXPONENT, STAT_PRIME_REJECTED_DUPLICATE, STAT_PRIME_REJECTED_TEST,
+    STAT_POLLARD_ITERATIONS, STAT_POLLARD_RESTARTS,
+    STAT_SIQS_POLYNOMIALS, STAT_SIQS_CANDIDATES, STAT_SIQS_RELATIONS, STAT_SIQS_PARTIALS, STAT_SIQS_JOINED,
+    STAT_DIST_UNITS, STAT_DIST_WORKERS, STAT_KEYGEN_SIEVED, STAT_POOL_HITS, STAT_POOL_MISSES,
+    STAT_COUNTERS
+};
+
+enum StatTimer { TIMER_GENERATE, TIMER_ENCRYPT, TIMER_DECRYPT, TIMER_FACTOR, TIMER_SIQS, STAT_TIMERS };
+
+/*
+ * Prints collected values as JSON object
+ */
+void printStats( std::ostream & out );
+
+#ifdef KRY_STATS
+#include <atomic>
+#include <chrono>
+
+extern std::atomic<uint64_t> statCounters[STAT_COUNTERS];
+extern std::atomic<uint64_t> statTimers[STAT_TIMERS];
+
+class StatScope {
+public:
+    explicit StatScope( StatTimer timer ) : timer_( timer ), start_( std::chrono::steady_clock::now() ) {}
+    ~StatScope() {
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start_ ).count();
+        statTimers[timer_].fetch_add( elapsed, std::memory_order_relaxed );
+    }
+
+private:
+    StatTimer                             timer_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#define STAT_CONCAT2( a, b ) a##b
+#define STAT_CONCAT( a, b ) STAT_CONCAT2( a, b )
+#define STAT_ADD( counter, value ) statCounters[counter].fetch_add( value, std::memory_order_relaxed )
+#define STAT_INC( counter ) STAT_ADD( counter, 1 )
+#define STAT_TIME( timer ) StatScope STAT_CONCAT( statScope, __LINE__ )( timer )
+#else
+#define STAT_ADD( counter, value ) ( (void) 0 )
+#define STAT_INC( counter ) ( (void) 0 )
+#define STAT_TIME( timer ) ( (void) 0 )
+#endif
+
+#endif
@@ -101,3 +101,27 @@ test_out "$m_test" "$M"
 echo "Testing -b"
 out=$(./kry -b $E $N $C)
 test_out "$out" "$P $Q $M"
+
+echo "Testing -g -n"
+for BITS in 50 100 1026; do
+	./kry -g $BITS -n 5 keys.tmp
+	test_out "$? $(wc -l < keys.tmp)" "^0 5$"
+done
+rm -f keys.tmp
+
+echo "Testing -P fill"
+export KRY_POOL=$(mktemp -d)
+for BITS in 50 61; do
+	./kry -P fill $BITS 10
+	test_out "$? $(./kry -P info $BITS)" "^0 .* $BITS 10 "
+done
+rm -rf "$KRY_POOL"
+unset KRY_POOL
+
+echo "Testing -d with primes"
+out=$(./kry -d $D $N $C $P $Q)
+test_out "$? $out" "^0 $M$"
+./kry -d $D $N $C $P 2>/dev/null
+test_out "$?" "^5$"
+./kry -d $D $N $C $P $P 2>/dev/null
+test_out "$?" "^5$"